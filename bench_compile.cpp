@@ -0,0 +1,434 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "stream.hpp"
+
+// verify iostream-free status
+#if _GLIBCXX_IOSTREAM
+#error rogue iostream acquired
+#endif
+
+namespace stream {
+
+// deferred initialization by main()
+in cin;
+out cout;
+out cerr;
+
+} // namespace stream
+
+// compile-cost benchmark of the constexpr renderer: builds a translation unit over a matrix of compilers, optimisation
+// levels, image resolutions and scene sizes, and reports wall time, cpu time and peak memory of each build as csv
+
+struct Build {
+	enum Status {
+		STATUS_OK,
+		STATUS_FAIL,
+		STATUS_MISSING
+	} status;
+
+	double wall;
+	double user;
+	double sys;
+	long peak_rss; // KB
+};
+
+// scene of a build: a procedural lattice of that many voxels, 0 standing for the built-in scene, or a header
+// generated by scene2hpp, of that many voxels
+struct Scene {
+	int voxels;
+	std::string header;
+};
+
+static double seconds(const timeval& tv)
+{
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double seconds(const timespec& ts)
+{
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// run a command to completion; child stdout goes to fd_out, if valid, otherwise nowhere, same as child stderr
+static Build run(
+	const std::vector< std::string >& args,
+	const int fd_out = -1)
+{
+	std::vector< char* > argv;
+
+	for (std::vector< std::string >::const_iterator it = args.begin(); it != args.end(); ++it)
+		argv.push_back(const_cast< char* >(it->c_str()));
+
+	argv.push_back(0);
+
+	Build build = { Build::STATUS_FAIL, 0, 0, 0, 0 };
+	timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	const pid_t pid = fork();
+
+	if (-1 == pid) {
+		stream::cerr << __FUNCTION__ << " cannot fork\n";
+		return build;
+	}
+
+	if (0 == pid) {
+		const int fd_null = open("/dev/null", O_WRONLY);
+		dup2(-1 != fd_out ? fd_out : fd_null, STDOUT_FILENO);
+		dup2(fd_null, STDERR_FILENO);
+		execvp(argv[0], argv.data());
+		_exit(127);
+	}
+
+	int status;
+	rusage usage;
+
+	if (-1 == wait4(pid, &status, 0, &usage)) {
+		stream::cerr << __FUNCTION__ << " cannot wait for child\n";
+		return build;
+	}
+
+	timespec finish;
+	clock_gettime(CLOCK_MONOTONIC, &finish);
+
+	build.wall = seconds(finish) - seconds(start);
+	build.user = seconds(usage.ru_utime);
+	build.sys = seconds(usage.ru_stime);
+	build.peak_rss = usage.ru_maxrss;
+
+	if (WIFEXITED(status) && 0 == WEXITSTATUS(status))
+		build.status = Build::STATUS_OK;
+	else
+	if (WIFEXITED(status) && 127 == WEXITSTATUS(status))
+		build.status = Build::STATUS_MISSING;
+
+	return build;
+}
+
+static std::string getVersion(
+	const std::string& compiler,
+	const char* const query)
+{
+	int fd[2];
+
+	if (-1 == pipe(fd))
+		return std::string();
+
+	std::vector< std::string > args;
+	args.push_back(compiler);
+	args.push_back(query);
+
+	const Build build = run(args, fd[1]);
+	close(fd[1]);
+
+	char buffer[64];
+	const ssize_t len = read(fd[0], buffer, sizeof(buffer));
+	close(fd[0]);
+
+	if (Build::STATUS_OK != build.status || 0 >= len)
+		return std::string();
+
+	std::string version(buffer, len);
+	version.erase(version.find_last_not_of(" \t\n") + 1);
+	return version;
+}
+
+static std::string getVersion(const std::string& compiler)
+{
+	// g++ reports major version only to -dumpversion
+	const std::string version = getVersion(compiler, "-dumpfullversion");
+
+	if (!version.empty())
+		return version;
+
+	return getVersion(compiler, "-dumpversion");
+}
+
+static bool isClang(const std::string& compiler)
+{
+	return std::string::npos != compiler.find("clang");
+}
+
+static std::vector< std::string > compileArgs(
+	const std::string& compiler,
+	const std::string& src,
+	const int opt,
+	const int res,
+	const Scene& scene)
+{
+	char buffer[64];
+	std::vector< std::string > args;
+
+	args.push_back(compiler);
+	args.push_back("-std=c++14");
+	args.push_back("-c");
+	args.push_back("-o");
+	args.push_back("/dev/null");
+	args.push_back(src);
+	args.push_back("-fno-exceptions");
+	args.push_back("-fno-rtti");
+
+	snprintf(buffer, sizeof(buffer), "-O%d", opt);
+	args.push_back(buffer);
+	snprintf(buffer, sizeof(buffer), "-DIMAGE_W=%d", res);
+	args.push_back(buffer);
+	snprintf(buffer, sizeof(buffer), "-DIMAGE_H=%d", res);
+	args.push_back(buffer);
+
+	if (!scene.header.empty()) {
+		args.push_back("-I.");
+		args.push_back("-DSCENE_HEADER=\"" + scene.header + '"');
+	}
+	else
+	if (0 != scene.voxels) {
+		snprintf(buffer, sizeof(buffer), "-DSCENE_VOXELS=%d", scene.voxels);
+		args.push_back(buffer);
+	}
+
+	return args;
+}
+
+// find the least constexpr-ops limit the build passes under, i.e. the ops use of the costliest constant expression
+// in the translation unit; only the front end is run; returns zero if no limit up to 2^40 passes
+static uint64_t findOpsUse(
+	const std::vector< std::string >& compile_args,
+	const bool clang)
+{
+	const char* const limit_flag = clang ? "-fconstexpr-steps=" : "-fconstexpr-ops-limit=";
+	std::vector< std::string > args(compile_args);
+
+	args[2] = "-fsyntax-only";
+	args.erase(args.begin() + 3, args.begin() + 5); // drop -o /dev/null
+	args.push_back(std::string());
+
+	char buffer[64];
+	uint64_t lo = 0; // highest failing limit
+	uint64_t hi = 1 << 10; // lowest passing limit, once found
+
+	while (true) {
+		snprintf(buffer, sizeof(buffer), "%s%llu", limit_flag, (unsigned long long) hi);
+		args.back() = buffer;
+
+		if (Build::STATUS_OK == run(args).status)
+			break;
+
+		lo = hi;
+		hi *= 4;
+
+		if (hi > uint64_t(1) << 40)
+			return 0;
+	}
+
+	while (hi - lo > 1) {
+		const uint64_t mid = lo + (hi - lo) / 2;
+		snprintf(buffer, sizeof(buffer), "%s%llu", limit_flag, (unsigned long long) mid);
+		args.back() = buffer;
+
+		if (Build::STATUS_OK == run(args).status)
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	return hi;
+}
+
+static std::vector< std::string > splitList(const char* const list)
+{
+	std::vector< std::string > items;
+	const char* start = list;
+
+	for (const char* it = list; ; ++it) {
+		if (',' == *it || '\0' == *it) {
+			if (it != start)
+				items.push_back(std::string(start, it));
+
+			if ('\0' == *it)
+				break;
+
+			start = it + 1;
+		}
+	}
+
+	return items;
+}
+
+static bool splitIntList(const char* const list, std::vector< int >& items)
+{
+	const std::vector< std::string > strs = splitList(list);
+	items.clear();
+
+	for (std::vector< std::string >::const_iterator it = strs.begin(); it != strs.end(); ++it) {
+		char* end;
+		const long val = strtol(it->c_str(), &end, 10);
+
+		if ('\0' != *end || 0 > val)
+			return false;
+
+		items.push_back(int(val));
+	}
+
+	return !items.empty();
+}
+
+// voxel count of a header generated by scene2hpp, as given by its SCENE_TABLE_VOXELS; -1 if not found
+static int getHeaderVoxels(const std::string& header)
+{
+	stream::in in;
+
+	if (!in.open(header.c_str()))
+		return -1;
+
+	std::string token;
+
+	while (!in.is_eof()) {
+		in >> token;
+
+		if ("SCENE_TABLE_VOXELS" == token) {
+			int32_t voxels;
+			in >> voxels;
+			return in.is_fail() || !in.is_good() ? -1 : voxels;
+		}
+	}
+
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	stream::cin.open(stdin);
+	stream::cout.open(stdout);
+	stream::cerr.open(stderr);
+
+	std::vector< std::string > compilers = splitList("g++,clang++");
+	std::vector< int > opts(1, 1);
+	std::vector< int > resolutions;
+	std::vector< int > lattices;
+	std::vector< std::string > headers;
+	std::string src("main.cpp");
+	bool report_ops = false;
+	int repeat = 1;
+
+	splitIntList("64,128,256", resolutions);
+	splitIntList("0,8,64", lattices);
+
+	for (int i = 1; i < argc; ++i) {
+		bool success = true;
+
+		if (!strcmp(argv[i], "-cc") && i + 1 < argc)
+			compilers = splitList(argv[++i]);
+		else
+		if (!strcmp(argv[i], "-opt") && i + 1 < argc)
+			success = splitIntList(argv[++i], opts);
+		else
+		if (!strcmp(argv[i], "-res") && i + 1 < argc)
+			success = splitIntList(argv[++i], resolutions);
+		else
+		if (!strcmp(argv[i], "-voxels") && i + 1 < argc)
+			success = splitIntList(argv[++i], lattices);
+		else
+		if (!strcmp(argv[i], "-scene") && i + 1 < argc)
+			headers = splitList(argv[++i]);
+		else
+		if (!strcmp(argv[i], "-src") && i + 1 < argc)
+			src = argv[++i];
+		else
+		if (!strcmp(argv[i], "-repeat") && i + 1 < argc)
+			success = 0 < (repeat = atoi(argv[++i]));
+		else
+		if (!strcmp(argv[i], "-ops"))
+			report_ops = true;
+		else
+			success = false;
+
+		if (!success) {
+			stream::cerr << "usage: " << argv[0] << " [options]\n"
+				"\t-cc list      : compilers, comma-separated (default: g++,clang++)\n"
+				"\t-opt list     : optimisation levels (default: 1)\n"
+				"\t-res list     : square image resolutions (default: 64,128,256)\n"
+				"\t-voxels list  : scene sizes in voxels; 0 stands for the built-in scene (default: 0,8,64)\n"
+				"\t-scene list   : further scenes, as headers generated by scene2hpp\n"
+				"\t-src file     : translation unit to build (default: main.cpp)\n"
+				"\t-repeat n     : builds per configuration, fastest reported (default: 1)\n"
+				"\t-ops          : report constexpr-ops use of the costliest constant expression, by bisection of the\n"
+				"\t                compiler's ops limit; costs some forty extra front-end runs per configuration\n";
+			return -1;
+		}
+	}
+
+	std::vector< Scene > scenes;
+
+	for (std::vector< int >::const_iterator it = lattices.begin(); it != lattices.end(); ++it) {
+		const Scene scene = { *it, std::string() };
+		scenes.push_back(scene);
+	}
+
+	for (std::vector< std::string >::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+		const Scene scene = { getHeaderVoxels(*it), *it };
+
+		if (0 > scene.voxels) {
+			stream::cerr << "error: '" << *it << "' is not a scene header\n";
+			return -1;
+		}
+
+		scenes.push_back(scene);
+	}
+
+	stream::cout << "compiler,version,opt,image_w,image_h,voxels,status,wall_s,user_s,sys_s,peak_rss_kb,constexpr_ops,scene,wall_us_per_voxel\n";
+	stream::cout.flush();
+
+	for (std::vector< std::string >::const_iterator cc = compilers.begin(); cc != compilers.end(); ++cc) {
+		const std::string version = getVersion(*cc);
+
+		for (std::vector< int >::const_iterator opt = opts.begin(); opt != opts.end(); ++opt)
+			for (std::vector< int >::const_iterator res = resolutions.begin(); res != resolutions.end(); ++res)
+				for (std::vector< Scene >::const_iterator scene = scenes.begin(); scene != scenes.end(); ++scene) {
+					const std::vector< std::string > args = compileArgs(*cc, src, *opt, *res, *scene);
+					Build best = run(args);
+
+					for (int i = 1; i < repeat && Build::STATUS_OK == best.status; ++i) {
+						const Build build = run(args);
+
+						if (build.wall < best.wall)
+							best = build;
+					}
+
+					const char* const status[] = { "ok", "fail", "missing" };
+					stream::cout << *cc << ',' << version << ',' << int32_t(*opt) << ',' <<
+						int32_t(*res) << ',' << int32_t(*res) << ',' << int32_t(scene->voxels) << ',' << status[best.status] << ',' <<
+						best.wall << ',' << best.user << ',' << best.sys << ',' << int64_t(best.peak_rss) << ',';
+
+					if (report_ops && Build::STATUS_OK == best.status)
+						stream::cout << uint64_t(findOpsUse(args, isClang(*cc)));
+
+					// per voxel of a non-built-in scene, the image cost included
+					stream::cout << ',' << scene->header << ',';
+
+					if (Build::STATUS_OK == best.status && (0 != scene->voxels || !scene->header.empty()))
+						stream::cout << best.wall * 1e6 / std::max(scene->voxels, 1);
+
+					stream::cout << '\n';
+					stream::cout.flush();
+
+					if (Build::STATUS_MISSING == best.status)
+						goto next_compiler;
+				}
+
+	next_compiler:
+		;
+	}
+
+	return 0;
+}
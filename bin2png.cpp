@@ -1,14 +1,22 @@
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <png.h>
-
-#ifndef Z_BEST_COMPRESSION
-#define Z_BEST_COMPRESSION 9
-#endif
+#include <zlib.h>
+#include <glob.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "scoped.hpp"
 #include "stream.hpp"
+#include "imagebin.hpp"
 
 // verify iostream-free status
 #if _GLIBCXX_IOSTREAM
@@ -113,13 +121,377 @@ char* get_buffer_from_file(
 	return ret;
 }
 
+static
+char* get_buffer_from_stream(
+	FILE* const file,
+	size_t& size)
+{
+	assert(0 != file);
+
+	size_t capacity = 1 << 20;
+	char* source = reinterpret_cast< char* >(malloc(capacity));
+	size = 0;
+
+	// grow the buffer twofold until the stream runs dry
+	while (0 != source && capacity == (size += fread(source + size, 1, capacity - size, file))) {
+		char* const grown = reinterpret_cast< char* >(realloc(source, capacity *= 2));
+
+		if (0 == grown)
+			free(source);
+
+		source = grown;
+	}
+
+	if (0 == source) {
+		stream::cerr << __FUNCTION__ << " cannot allocate memory for stream\n";
+		return 0;
+	}
+
+	if (ferror(file)) {
+		stream::cerr << __FUNCTION__ << " cannot read from stream\n";
+		free(source);
+		return 0;
+	}
+
+	return source;
+}
+
+// file contents, mapped where the file is a regular one, read into a buffer otherwise -- pipes, devices, or failure to
+// map; - stands for stdin
+class FileBuffer : testbed::non_copyable {
+	void* bits;
+	size_t length;
+	bool mapped;
+
+public:
+	explicit FileBuffer(const char* const filename)
+	: bits(0)
+	, length(0)
+	, mapped(false) {
+		assert(0 != filename);
+
+		if (!strcmp(filename, "-")) {
+			bits = get_buffer_from_stream(stdin, length);
+			return;
+		}
+
+		const int fd = open(filename, O_RDONLY);
+		struct stat filestat;
+		bool regular = false;
+
+		if (-1 != fd && 0 == fstat(fd, &filestat) && S_ISREG(filestat.st_mode)) {
+			regular = true;
+			void* const map = 0 < filestat.st_size ? mmap(0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+			if (MAP_FAILED != map) {
+				// rows are consumed bottom-up, so ask for the whole file ahead rather than for sequential read-ahead
+				madvise(map, filestat.st_size, MADV_WILLNEED);
+				bits = map;
+				length = filestat.st_size;
+				mapped = true;
+			}
+		}
+
+		if (-1 != fd)
+			close(fd);
+
+		if (mapped)
+			return;
+
+		if (regular) {
+			bits = get_buffer_from_file(filename, length, 16);
+			return;
+		}
+
+		const testbed::scoped_ptr< FILE, testbed::scoped_functor > file(fopen(filename, "rb"));
+
+		if (0 == file()) {
+			stream::cerr << __FUNCTION__ << " cannot open file '" << filename << "'\n";
+			return;
+		}
+
+		bits = get_buffer_from_stream(file(), length);
+	}
+
+	~FileBuffer() {
+		if (mapped)
+			munmap(bits, length);
+		else
+			free(bits);
+	}
+
+	void* operator ()() const {
+		return bits;
+	}
+
+	size_t size() const {
+		return length;
+	}
+};
+
+// encoder settings: zlib level, strategy, window and memory level, the row filters libpng picks from per row, and
+// whether images of few colours are reduced to gray or palette
+struct PngProfile {
+	int level;
+	int strategy;
+	int window_bits;
+	int mem_level;
+	int filters;
+	bool reduce;
+};
+
+// image as encoded: rows top-down, of png samples, packed where below a byte
+struct PngImage {
+	unsigned width;
+	unsigned height;
+	int color_type;
+	int bit_depth;
+	const png_byte* top; // first row
+	ptrdiff_t step; // from a row to the next, negative for rows stored bottom-up
+	std::vector< png_color > palette;
+
+	const png_byte* row(const unsigned y) const {
+		return top + step * ptrdiff_t(y);
+	}
+
+	size_t row_bytes() const {
+		const int channels = PNG_COLOR_TYPE_RGB == color_type ? 3 : 1;
+		return (size_t(width) * channels * bit_depth + 7) / 8;
+	}
+
+	// bytes per complete pixel, one at least, as png filters take it
+	size_t pixel_bytes() const {
+		const int channels = PNG_COLOR_TYPE_RGB == color_type ? 3 : 1;
+		return std::max(1, channels * bit_depth / 8);
+	}
+};
+
+// an image.bin as is -- rgb8, rows bottom-up
+static PngImage rgb_image(
+	const ImageView& view)
+{
+	PngImage image;
+	image.width = view.width;
+	image.height = view.height;
+	image.color_type = PNG_COLOR_TYPE_RGB;
+	image.bit_depth = 8;
+	image.top = view.pixels + view.stride * (view.height - 1);
+	image.step = -ptrdiff_t(view.stride);
+	return image;
+}
+
+// an image.bin of 256 colours or fewer as gray or palette, whichever of fewer bits per pixel, gray on a tie, as it takes
+// no palette; samples are packed into storage; false if the image has too many colours
+static bool reduce_image(
+	const ImageView& view,
+	PngImage& image,
+	std::vector< png_byte >& storage)
+{
+	// distinct colours, by open addressing over a table twice the palette size; entries hold colour + 1, zero for empty
+	const size_t table_size = 512;
+	uint32_t colour[table_size] = { 0 };
+	png_byte index[table_size];
+	size_t count = 0;
+	bool gray = true;
+
+	const auto find = [&](const uint32_t rgb) {
+		size_t slot = (rgb * 2654435761u) >> 23;
+
+		while (0 != colour[slot] && rgb + 1 != colour[slot])
+			slot = (slot + 1) % table_size;
+
+		return slot;
+	};
+
+	// renders run in long spans of a colour, so the colour of the last pixel is checked first
+	uint32_t last = UINT32_MAX;
+
+	for (uint32_t y = 0; y < view.height; ++y) {
+		const png_byte* const row = view.pixels + view.stride * y;
+
+		for (uint32_t x = 0; x < view.width; ++x) {
+			const png_byte* const p = row + x * 3;
+			const uint32_t rgb = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+
+			if (rgb == last)
+				continue;
+
+			const size_t slot = find(rgb);
+			last = rgb;
+
+			if (0 != colour[slot])
+				continue;
+
+			if (256 == count)
+				return false;
+
+			colour[slot] = rgb + 1;
+			gray = gray && p[0] == p[1] && p[1] == p[2];
+			++count;
+		}
+	}
+
+	// palette in colour order, for output independent of the table layout
+	std::vector< uint32_t > sorted;
+
+	for (size_t i = 0; i < table_size; ++i)
+		if (0 != colour[i])
+			sorted.push_back(colour[i] - 1);
+
+	std::sort(sorted.begin(), sorted.end());
+
+	// least gray depth that represents all levels exactly: levels at multiples of 255 / (2^depth - 1)
+	int gray_depth = 8;
+
+	for (int depth = 4; gray && depth >= 1; depth /= 2) {
+		const unsigned divisor = 255 / ((1 << depth) - 1);
+		bool exact = true;
+
+		for (size_t i = 0; i < sorted.size() && exact; ++i)
+			exact = 0 == (sorted[i] & 0xff) % divisor;
+
+		if (exact)
+			gray_depth = depth;
+	}
+
+	const int palette_depth = count <= 2 ? 1 : count <= 4 ? 2 : count <= 16 ? 4 : 8;
+
+	image.width = view.width;
+	image.height = view.height;
+	image.palette.clear();
+
+	if (gray && gray_depth <= palette_depth) {
+		image.color_type = PNG_COLOR_TYPE_GRAY;
+		image.bit_depth = gray_depth;
+	}
+	else {
+		image.color_type = PNG_COLOR_TYPE_PALETTE;
+		image.bit_depth = palette_depth;
+
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			const png_color c = { png_byte(sorted[i] >> 16), png_byte(sorted[i] >> 8), png_byte(sorted[i]) };
+			image.palette.push_back(c);
+			index[find(sorted[i])] = png_byte(i);
+		}
+	}
+
+	// pack samples, most significant bits first, rows top-down
+	const size_t row_bytes = image.row_bytes();
+	const unsigned gray_divisor = 255 / ((1 << image.bit_depth) - 1);
+	storage.assign(row_bytes * view.height, 0);
+
+	unsigned sample = 0;
+	last = UINT32_MAX;
+
+	for (uint32_t y = 0; y < view.height; ++y) {
+		const png_byte* const row = view.pixels + view.stride * (view.height - 1 - y);
+		png_byte* const out = storage.data() + row_bytes * y;
+
+		for (uint32_t x = 0; x < view.width; ++x) {
+			const png_byte* const p = row + x * 3;
+			const uint32_t rgb = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+
+			if (rgb != last) {
+				sample = PNG_COLOR_TYPE_GRAY == image.color_type ? p[0] / gray_divisor : index[find(rgb)];
+				last = rgb;
+			}
+
+			const size_t bit = size_t(x) * image.bit_depth;
+
+			out[bit / 8] |= png_byte(sample << (8 - image.bit_depth - bit % 8));
+		}
+	}
+
+	image.top = storage.data();
+	image.step = ptrdiff_t(row_bytes);
+	return true;
+}
+
+struct NamedValue {
+	const char* name;
+	int value;
+};
+
+static const NamedValue png_strategy[] = {
+	{ "default", Z_DEFAULT_STRATEGY },
+	{ "filtered", Z_FILTERED },
+	{ "huffman", Z_HUFFMAN_ONLY },
+	{ "rle", Z_RLE },
+	{ "fixed", Z_FIXED }
+};
+
+static const NamedValue png_filter[] = {
+	{ "none", PNG_FILTER_NONE },
+	{ "sub", PNG_FILTER_SUB },
+	{ "up", PNG_FILTER_UP },
+	{ "avg", PNG_FILTER_AVG },
+	{ "paeth", PNG_FILTER_PAETH },
+	{ "all", PNG_ALL_FILTERS }
+};
+
+template < size_t N >
+static bool parse_named(
+	const char* const name,
+	const NamedValue (&table)[N],
+	int& value)
+{
+	for (size_t i = 0; i < N; ++i)
+		if (!strcmp(name, table[i].name)) {
+			value = table[i].value;
+			return true;
+		}
+
+	return false;
+}
+
+template < size_t N >
+static const char* get_name(
+	const int value,
+	const NamedValue (&table)[N])
+{
+	for (size_t i = 0; i < N; ++i)
+		if (value == table[i].value)
+			return table[i].name;
+
+	return "custom";
+}
+
+static bool parse_int(
+	const char* const str,
+	int& value,
+	const int min,
+	const int max)
+{
+	char* end;
+	const long v = strtol(str, &end, 10);
+
+	if (end == str || '\0' != *end || v < min || v > max)
+		return false;
+
+	value = int(v);
+	return true;
+}
+
+static void count_png_bytes(
+	png_structp png_ptr,
+	png_bytep,
+	png_size_t length)
+{
+	*reinterpret_cast< size_t* >(png_get_io_ptr(png_ptr)) += length;
+}
+
+static void flush_nothing(
+	png_structp)
+{
+}
+
+// write to fp, or, if fp is nil, only count the bytes written into length
 static bool
 write_png(
-	const bool grayscale,
-	const unsigned w,
-	const unsigned h,
-	void* const bits,
-	FILE* const fp)
+	const PngImage& image,
+	const PngProfile& profile,
+	FILE* const fp,
+	size_t* const length = 0)
 {
 	using testbed::scoped_ptr;
 	using testbed::generic_free;
@@ -137,6 +509,7 @@ write_png(
 	}
 
 	// declare any RAII before the longjump, lest no destruction at longjump
+	const unsigned h = image.height;
 	const scoped_ptr< png_bytep, generic_free > row((png_bytepp) malloc(sizeof(png_bytep) * h));
 
 	if (setjmp(png_jmpbuf(png_ptr))) {
@@ -144,20 +517,27 @@ write_png(
 		return false;
 	}
 
-	size_t pixel_size = sizeof(png_byte[3]);
-	int color_type = PNG_COLOR_TYPE_RGB;
+	for (unsigned i = 0; i < h; ++i)
+		row()[i] = const_cast< png_bytep >(image.row(i));
 
-	if (grayscale) {
-		pixel_size = sizeof(png_byte);
-		color_type = PNG_COLOR_TYPE_GRAY;
+	if (0 != fp)
+		png_init_io(png_ptr, fp);
+	else {
+		assert(0 != length);
+		*length = 0;
+		png_set_write_fn(png_ptr, length, count_png_bytes, flush_nothing);
 	}
 
-	for (size_t i = 0; i < h; ++i)
-		row()[i] = (png_bytep) bits + w * (h - 1 - i) * pixel_size;
+	png_set_compression_level(png_ptr, profile.level);
+	png_set_compression_strategy(png_ptr, profile.strategy);
+	png_set_compression_window_bits(png_ptr, profile.window_bits);
+	png_set_compression_mem_level(png_ptr, profile.mem_level);
+	png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, profile.filters);
+	png_set_IHDR(png_ptr, info_ptr, image.width, h, image.bit_depth, image.color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+	if (!image.palette.empty())
+		png_set_PLTE(png_ptr, info_ptr, image.palette.data(), int(image.palette.size()));
 
-	png_init_io(png_ptr, fp);
-	png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
-	png_set_IHDR(png_ptr, info_ptr, w, h, 8, color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 	png_set_rows(png_ptr, info_ptr, row());
 	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
 
@@ -165,45 +545,601 @@ write_png(
 	return true;
 }
 
-int main(int, char**)
+static int paeth_predictor(
+	const int a,
+	const int b,
+	const int c)
 {
-	stream::cin.open(stdin);
-	stream::cout.open(stdout);
-	stream::cerr.open(stderr);
+	const int p = a + b - c;
+	const int pa = abs(p - a);
+	const int pb = abs(p - b);
+	const int pc = abs(p - c);
 
-	using testbed::scoped_ptr;
-	using testbed::scoped_functor;
-	using testbed::generic_free;
+	return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
 
-	const char inputName[] = "image.bin";
-	size_t inputLength = 0;
-	const scoped_ptr< void, generic_free > input(get_buffer_from_file(inputName, inputLength, 16));
+// filter a row into out, its filter type byte first; with several filters allowed, pick the one of least sum of
+// absolute residuals, as libpng does; prev is nil for the first row of the image
+static void filter_row(
+	const png_byte* const row,
+	const png_byte* const prev,
+	const size_t row_bytes,
+	const size_t pixel_size,
+	const int filters,
+	png_byte* const out,
+	png_byte* const scratch)
+{
+	static const int filter_bit[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH };
+	size_t best_sum = SIZE_MAX;
 
-	if (0 == input()) {
-		stream::cerr << "failure opening input file\n";
-		return -1;
+	for (int type = 0; type < 5; ++type) {
+		if (0 == (filters & filter_bit[type]))
+			continue;
+
+		png_byte* const dst = best_sum == SIZE_MAX ? out + 1 : scratch;
+		const size_t lead = std::min(pixel_size, row_bytes);
+
+		// the leading pixel has no left neighbour, nor an upper-left one
+		switch (type) {
+		case 0:
+			memcpy(dst, row, row_bytes);
+			break;
+		case 1:
+			memcpy(dst, row, lead);
+
+			for (size_t i = lead; i < row_bytes; ++i)
+				dst[i] = png_byte(row[i] - row[i - pixel_size]);
+
+			break;
+		case 2:
+			for (size_t i = 0; i < row_bytes; ++i)
+				dst[i] = png_byte(row[i] - (0 != prev ? prev[i] : 0));
+
+			break;
+		case 3:
+			for (size_t i = 0; i < lead; ++i)
+				dst[i] = png_byte(row[i] - (0 != prev ? prev[i] : 0) / 2);
+
+			for (size_t i = lead; i < row_bytes; ++i)
+				dst[i] = png_byte(row[i] - (row[i - pixel_size] + (0 != prev ? prev[i] : 0)) / 2);
+
+			break;
+		case 4:
+			for (size_t i = 0; i < lead; ++i)
+				dst[i] = png_byte(row[i] - (0 != prev ? prev[i] : 0));
+
+			for (size_t i = lead; i < row_bytes; ++i)
+				dst[i] = png_byte(row[i] - (0 != prev ?
+					paeth_predictor(row[i - pixel_size], prev[i], prev[i - pixel_size]) : row[i - pixel_size]));
+
+			break;
+		}
+
+		// a single filter allowed takes no picking
+		if (filters == filter_bit[type]) {
+			out[0] = png_byte(type);
+			return;
+		}
+
+		size_t sum = 0;
+
+		for (size_t i = 0; i < row_bytes; ++i)
+			sum += dst[i] < 128 ? dst[i] : 256 - dst[i];
+
+		if (sum < best_sum) {
+			if (dst != out + 1)
+				memcpy(out + 1, dst, row_bytes);
+
+			out[0] = png_byte(type);
+			best_sum = sum;
+		}
 	}
+}
 
-	const size_t image_w = reinterpret_cast< uint16_t* >(input())[0];
-	const size_t image_h = reinterpret_cast< uint16_t* >(input())[1];
+static void put_be32(
+	std::vector< png_byte >& out,
+	const uint32_t value)
+{
+	out.push_back(png_byte(value >> 24));
+	out.push_back(png_byte(value >> 16));
+	out.push_back(png_byte(value >> 8));
+	out.push_back(png_byte(value));
+}
 
-	if (image_w * image_h * sizeof(uint8_t[3]) + sizeof(uint16_t[2]) != inputLength) {
-		stream::cerr << "input file dimensions mismatch; not an image or corrupt?\n";
-		return -1;
+// write to fp, or, if fp is nil, only count the bytes written into written
+static bool write_chunk(
+	const char (&type)[5],
+	const png_byte* const data,
+	const size_t length,
+	FILE* const fp,
+	size_t& written)
+{
+	std::vector< png_byte > head;
+	put_be32(head, uint32_t(length));
+	head.insert(head.end(), type, type + 4);
+
+	std::vector< png_byte > tail;
+	// crc32 of a nil buffer resets the crc
+	const uLong crc = crc32(crc32(0, 0, 0), head.data() + 4, 4);
+	put_be32(tail, uint32_t(0 != length ? crc32(crc, data, uInt(length)) : crc));
+
+	written += head.size() + length + tail.size();
+
+	return 0 == fp || (
+		1 == fwrite(head.data(), head.size(), 1, fp) &&
+		(0 == length || 1 == fwrite(data, length, 1, fp)) &&
+		1 == fwrite(tail.data(), tail.size(), 1, fp));
+}
+
+// same as write_png, fp nil likewise, the image data deflated over num_threads threads, pigz-style: rows are filtered
+// and deflated in bands, each band primed with the last window of filtered rows before it and ended by a sync flush,
+// so that the bands concatenate into a single zlib stream, whose adler-32 is combined from those of the bands; output
+// decodes to the same image as that of write_png, but is not byte-identical to it
+static bool
+write_png_parallel(
+	const PngImage& image,
+	const PngProfile& profile,
+	const int num_threads,
+	FILE* const fp,
+	size_t* const length = 0)
+{
+	const unsigned h = image.height;
+	const size_t pixel_size = image.pixel_bytes();
+	const size_t row_bytes = image.row_bytes();
+	const size_t window = size_t(1) << profile.window_bits;
+	// bands of 128KB at least, fewer but longer on large images, each band costing a deflate block header and flush
+	const size_t band_bytes = std::max(size_t(1) << 17, h * (row_bytes + 1) / (num_threads * 8));
+	const unsigned band_rows = unsigned(std::max(size_t(1), band_bytes / (row_bytes + 1)));
+	const unsigned num_bands = (h + band_rows - 1) / band_rows;
+
+	struct Band {
+		std::vector< png_byte > deflated;
+		uLong adler;
+		uLong length;
+		bool success;
+	};
+
+	std::vector< Band > band(num_bands);
+	std::atomic< unsigned > next_band(0);
+
+	const auto worker = [&]() {
+		std::vector< png_byte > scratch(row_bytes);
+		std::vector< png_byte > filtered;
+
+		for (unsigned b; (b = next_band++) < num_bands; ) {
+			// filter the band, preceded by the rows that make up the window ahead of it
+			const unsigned first = b * band_rows;
+			const unsigned last = std::min(h, first + band_rows);
+			const unsigned ahead = std::min(first, unsigned((window + row_bytes) / (row_bytes + 1)));
+
+			filtered.resize((last - first + ahead) * (row_bytes + 1));
+
+			for (unsigned i = first - ahead; i < last; ++i)
+				filter_row(image.row(i), i ? image.row(i - 1) : 0, row_bytes, pixel_size, profile.filters,
+					filtered.data() + (i - first + ahead) * (row_bytes + 1), scratch.data());
+
+			const size_t dict = std::min(size_t(ahead) * (row_bytes + 1), window);
+			const png_byte* const data = filtered.data() + size_t(ahead) * (row_bytes + 1);
+			const size_t length = filtered.size() - size_t(ahead) * (row_bytes + 1);
+
+			z_stream strm;
+			memset(&strm, 0, sizeof(strm));
+			band[b].success = false;
+
+			if (Z_OK != deflateInit2(&strm, profile.level, Z_DEFLATED, -profile.window_bits, profile.mem_level, profile.strategy))
+				continue;
+
+			if (dict)
+				deflateSetDictionary(&strm, data - dict, uInt(dict));
+
+			// deflate the lot, growing the output until a call leaves room to spare, past which output is complete
+			const int flush = b + 1 == num_bands ? Z_FINISH : Z_SYNC_FLUSH;
+			int ret = Z_OK;
+
+			band[b].deflated.resize(deflateBound(&strm, uLong(length)));
+			strm.next_in = const_cast< png_byte* >(data);
+			strm.avail_in = uInt(length);
+
+			do {
+				if (strm.total_out == band[b].deflated.size())
+					band[b].deflated.resize(band[b].deflated.size() * 2);
+
+				strm.next_out = band[b].deflated.data() + strm.total_out;
+				strm.avail_out = uInt(band[b].deflated.size() - strm.total_out);
+				ret = deflate(&strm, flush);
+			}
+			while (Z_OK == ret && 0 == strm.avail_out);
+
+			band[b].success = (Z_FINISH == flush ? Z_STREAM_END : Z_OK) == ret && 0 == strm.avail_in;
+			band[b].deflated.resize(strm.total_out);
+			band[b].adler = adler32(adler32(0, 0, 0), data, uInt(length));
+			band[b].length = uLong(length);
+			deflateEnd(&strm);
+		}
+	};
+
+	std::vector< std::thread > threads;
+
+	for (int i = 1; i < num_threads; ++i)
+		threads.push_back(std::thread(worker));
+
+	worker();
+
+	for (std::vector< std::thread >::iterator it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	// zlib header, deflate bands, adler-32 of the lot
+	const int level_flag = profile.level < 2 ? 0 : profile.level < 6 ? 1 : 6 == profile.level ? 2 : 3;
+	const unsigned cmf = (profile.window_bits - 8) << 4 | Z_DEFLATED;
+	const unsigned flg = level_flag << 6;
+
+	std::vector< png_byte > zlib;
+	zlib.push_back(png_byte(cmf));
+	zlib.push_back(png_byte(flg + 31 - (cmf << 8 | flg) % 31));
+
+	uLong adler = adler32(0, 0, 0);
+
+	for (unsigned b = 0; b < num_bands; ++b) {
+		if (!band[b].success)
+			return false;
+
+		zlib.insert(zlib.end(), band[b].deflated.begin(), band[b].deflated.end());
+		adler = adler32_combine(adler, band[b].adler, band[b].length);
+		std::vector< png_byte >().swap(band[b].deflated);
 	}
 
-	const char outName[] = "image.png";
+	put_be32(zlib, uint32_t(adler));
+
+	static const png_byte signature[] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	std::vector< png_byte > ihdr;
+	put_be32(ihdr, image.width);
+	put_be32(ihdr, h);
+	ihdr.push_back(png_byte(image.bit_depth));
+	ihdr.push_back(png_byte(image.color_type));
+	ihdr.push_back(PNG_COMPRESSION_TYPE_BASE);
+	ihdr.push_back(PNG_FILTER_TYPE_BASE);
+	ihdr.push_back(PNG_INTERLACE_NONE);
+
+	size_t written = sizeof(signature);
+
+	if ((0 != fp && 1 != fwrite(signature, sizeof(signature), 1, fp)) || !write_chunk("IHDR", ihdr.data(), ihdr.size(), fp, written))
+		return false;
+
+	if (!image.palette.empty() &&
+		!write_chunk("PLTE", &image.palette.front().red, image.palette.size() * sizeof(png_color), fp, written))
+		return false;
+
+	// IDAT chunks of at most 1MB
+	const size_t max_idat = 1 << 20;
+
+	for (size_t offset = 0; offset < zlib.size(); offset += max_idat)
+		if (!write_chunk("IDAT", zlib.data() + offset, std::min(max_idat, zlib.size() - offset), fp, written))
+			return false;
+
+	if (!write_chunk("IEND", 0, 0, fp, written))
+		return false;
+
+	if (0 != length)
+		*length = written;
+
+	return true;
+}
+
+// validate an image.bin, v1 or v2, and locate its pixels
+static bool get_image(
+	const char* const filename,
+	const FileBuffer& input,
+	ImageView& view)
+{
+	if (0 == input()) {
+		stream::cerr << "failure opening input file '" << filename << "'\n";
+		return false;
+	}
+
+	if (!readImage(input(), input.size(), view)) {
+		stream::cerr << "input file '" << filename << "' malformed; not an image or corrupt?\n";
+		return false;
+	}
+
+	return true;
+}
+
+static bool convert(
+	const char* const inputName,
+	const char* const outName,
+	const PngProfile& profile,
+	const int num_threads)
+{
+	using testbed::scoped_ptr;
+	using testbed::scoped_functor;
+
+	const FileBuffer input(inputName);
+	ImageView view;
+
+	if (!get_image(inputName, input, view))
+		return false;
+
+	std::vector< png_byte > storage;
+	PngImage image;
+
+	if (!profile.reduce || !reduce_image(view, image, storage))
+		image = rgb_image(view);
+
 	const scoped_ptr< FILE, scoped_functor > file(fopen(outName, "wb"));
 
 	if (0 == file()) {
 		stream::cerr << "failure opening output file '" << outName << "'\n";
-		return -1;
+		return false;
 	}
 
-	if (!write_png(false, image_w, image_h, reinterpret_cast< uint16_t* >(input()) + 2, file())) {
+	const bool success = num_threads > 1 ?
+		write_png_parallel(image, profile, num_threads, file()) :
+		write_png(image, profile, file());
+
+	if (!success) {
 		stream::cerr << "failure writing output file '" << outName << "'\n";
-		return -1;
+		return false;
+	}
+
+	return true;
+}
+
+struct Job {
+	std::string input;
+	std::string output;
+};
+
+// output of an input by default: its .bin suffix, if any, replaced by .png
+static std::string default_output(
+	const std::string& input)
+{
+	const size_t suffix = input.size() >= 4 && !input.compare(input.size() - 4, 4, ".bin") ? input.size() - 4 : input.size();
+	return input.substr(0, suffix) + ".png";
+}
+
+// list of jobs, a line each: input file, optionally followed by whitespace and output file
+static bool read_job_list(
+	const char* const filename,
+	std::vector< Job >& jobs)
+{
+	FILE* const file = strcmp(filename, "-") ? fopen(filename, "r") : stdin;
+
+	if (0 == file) {
+		stream::cerr << "failure opening job list '" << filename << "'\n";
+		return false;
+	}
+
+	char line[4096];
+
+	while (0 != fgets(line, sizeof(line), file)) {
+		char* const input = strtok(line, " \t\r\n");
+
+		if (0 == input)
+			continue;
+
+		const char* const output = strtok(0, " \t\r\n");
+		const Job job = { input, 0 != output ? std::string(output) : default_output(input) };
+		jobs.push_back(job);
+	}
+
+	if (stdin != file)
+		fclose(file);
+
+	return true;
+}
+
+static bool glob_jobs(
+	const char* const pattern,
+	std::vector< Job >& jobs)
+{
+	glob_t found;
+
+	if (0 != glob(pattern, 0, 0, &found)) {
+		stream::cerr << "no match for pattern '" << pattern << "'\n";
+		return false;
+	}
+
+	for (size_t i = 0; i < found.gl_pathc; ++i) {
+		const Job job = { found.gl_pathv[i], default_output(found.gl_pathv[i]) };
+		jobs.push_back(job);
+	}
+
+	globfree(&found);
+	return true;
+}
+
+// convert jobs over a pool of num_jobs workers, each taking the next job once done with its own, so that reading,
+// encoding and writing of different files overlap; returns the count of failed jobs
+static size_t convert_batch(
+	const std::vector< Job >& jobs,
+	const PngProfile& profile,
+	const int num_threads,
+	const int num_jobs)
+{
+	std::atomic< size_t > next_job(0);
+	std::atomic< size_t > failed(0);
+
+	const auto worker = [&]() {
+		for (size_t i; (i = next_job++) < jobs.size(); )
+			if (!convert(jobs[i].input.c_str(), jobs[i].output.c_str(), profile, num_threads))
+				++failed;
+	};
+
+	std::vector< std::thread > threads;
+
+	for (int i = 1; i < num_jobs; ++i)
+		threads.push_back(std::thread(worker));
+
+	worker();
+
+	for (std::vector< std::thread >::iterator it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	return failed;
+}
+
+int main(int argc, char** argv)
+{
+	stream::cin.open(stdin);
+	stream::cout.open(stdout);
+	stream::cerr.open(stderr);
+
+	const char* inputName = "image.bin";
+	const char* outName = "image.png";
+	std::vector< Job > jobs;
+	int num_jobs = std::max(1u, std::thread::hardware_concurrency());
+	PngProfile profile = { Z_BEST_COMPRESSION, Z_FILTERED, 15, 8, PNG_ALL_FILTERS, true };
+	int bench = 0;
+	int num_threads = 1;
+
+	for (int i = 1; i < argc; ++i) {
+		bool success = true;
+
+		if (!strcmp(argv[i], "-i") && i + 1 < argc)
+			inputName = argv[++i];
+		else
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outName = argv[++i];
+		else
+		if (!strcmp(argv[i], "-batch") && i + 1 < argc)
+			success = read_job_list(argv[++i], jobs);
+		else
+		if (!strcmp(argv[i], "-glob") && i + 1 < argc)
+			success = glob_jobs(argv[++i], jobs);
+		else
+		if (!strcmp(argv[i], "-jobs") && i + 1 < argc)
+			success = parse_int(argv[++i], num_jobs, 1, 1024);
+		else
+		if (!strcmp(argv[i], "-level") && i + 1 < argc)
+			success = parse_int(argv[++i], profile.level, 0, 9);
+		else
+		if (!strcmp(argv[i], "-strategy") && i + 1 < argc)
+			success = parse_named(argv[++i], png_strategy, profile.strategy);
+		else
+		if (!strcmp(argv[i], "-window") && i + 1 < argc)
+			success = parse_int(argv[++i], profile.window_bits, 9, 15);
+		else
+		if (!strcmp(argv[i], "-memlevel") && i + 1 < argc)
+			success = parse_int(argv[++i], profile.mem_level, 1, 9);
+		else
+		if (!strcmp(argv[i], "-filter") && i + 1 < argc) {
+			// comma-separated list of filters
+			char* const list = argv[++i];
+			profile.filters = 0;
+
+			for (char* name = strtok(list, ","); 0 != name && success; name = strtok(0, ",")) {
+				int filter = 0;
+				success = parse_named(name, png_filter, filter);
+				profile.filters |= filter;
+			}
+
+			success = success && 0 != profile.filters;
+		}
+		else
+		if (!strcmp(argv[i], "-rgb"))
+			profile.reduce = false;
+		else
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			success = parse_int(argv[++i], num_threads, 1, 1024);
+		else
+		if (!strcmp(argv[i], "-bench") && i + 1 < argc)
+			success = parse_int(argv[++i], bench, 1, 1000);
+		else
+			success = false;
+
+		if (!success) {
+			stream::cerr << "usage: " << argv[0] << " [options]\n"
+				"\t-i file          : input file, - for stdin (default: image.bin)\n"
+				"\t-o file          : output file (default: image.png)\n"
+				"\t-batch list      : convert the files of a list, - for stdin, instead; a line each, input file\n"
+				"\t                   optionally followed by output file (default: input with .bin replaced by .png);\n"
+				"\t                   repeatable\n"
+				"\t-glob pattern    : convert the files matching a pattern, as if listed with -batch; repeatable\n"
+				"\t-jobs n          : files converted at a time in batch mode (default: hardware concurrency)\n"
+				"\t-level n         : zlib compression level, 0..9 (default: 9)\n"
+				"\t-strategy name   : zlib strategy -- default, filtered, huffman, rle, fixed (default: filtered)\n"
+				"\t-window n        : zlib window bits, 9..15 (default: 15)\n"
+				"\t-memlevel n      : zlib memory level, 1..9 (default: 8)\n"
+				"\t-filter list     : comma-separated row filters to pick from -- none, sub, up, avg, paeth, all\n"
+				"\t                   (default: all)\n"
+				"\t-rgb             : always encode rgb, rather than gray or palette where the image has few colours\n"
+				"\t-threads n       : encode over n threads, in bands deflated in parallel (default: 1, through libpng)\n"
+				"\t-bench n         : encode the input over a sweep of levels, strategies and filters, n times each,\n"
+				"\t                   without writing it, and print a csv of throughput and output size\n";
+			return -1;
+		}
+	}
+
+	if (!jobs.empty()) {
+		const size_t failed = convert_batch(jobs, profile, num_threads, num_jobs);
+
+		if (failed) {
+			stream::cerr << "failure converting " << uint64_t(failed) << " of " << uint64_t(jobs.size()) << " file(s)\n";
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (bench) {
+		const FileBuffer input(inputName);
+		ImageView view;
+
+		if (!get_image(inputName, input, view))
+			return -1;
+
+		std::vector< png_byte > storage;
+		PngImage image;
+
+		if (!profile.reduce || !reduce_image(view, image, storage))
+			image = rgb_image(view);
+
+		stream::cerr << "encoding as " << (
+			PNG_COLOR_TYPE_GRAY == image.color_type ? "gray" :
+			PNG_COLOR_TYPE_PALETTE == image.color_type ? "palette" : "rgb") << ", " << int32_t(image.bit_depth) << "-bit\n";
+
+		static const int level[] = { 1, 3, 6, 9 };
+		static const int strategy[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE };
+		static const int filters[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_PAETH, PNG_ALL_FILTERS };
+		const double mb = size_t(view.width) * view.height * sizeof(uint8_t[3]) * 1e-6;
+
+		stream::cout << "level,strategy,filter,encode_ms,mb_per_s,png_bytes,ratio\n";
+
+		for (size_t l = 0; l < sizeof(level) / sizeof(level[0]); ++l)
+			for (size_t s = 0; s < sizeof(strategy) / sizeof(strategy[0]); ++s)
+				for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); ++f) {
+					const PngProfile sweep = { level[l], strategy[s], profile.window_bits, profile.mem_level, filters[f], profile.reduce };
+					size_t length = 0;
+					double best = 0;
+
+					// best of n, the least disturbed run
+					for (int run = 0; run < bench; ++run) {
+						timespec start, end;
+						clock_gettime(CLOCK_MONOTONIC, &start);
+
+						const bool success = num_threads > 1 ?
+							write_png_parallel(image, sweep, num_threads, 0, &length) :
+							write_png(image, sweep, 0, &length);
+
+						if (!success) {
+							stream::cerr << "failure encoding input\n";
+							return -1;
+						}
+
+						clock_gettime(CLOCK_MONOTONIC, &end);
+						const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+
+						if (0 == run || ms < best)
+							best = ms;
+					}
+
+					stream::cout << int32_t(level[l]) << ',' << get_name(strategy[s], png_strategy) << ',' <<
+						get_name(filters[f], png_filter) << ',' << best << ',' << mb / (best * 1e-3) << ',' <<
+						uint64_t(length) << ',' << double(length) / (mb * 1e6) << '\n';
+				}
+
+		return 0;
 	}
 
-	return 0;
+	return convert(inputName, outName, profile, num_threads) ? 0 : -1;
 }
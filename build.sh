@@ -1,4 +1,7 @@
 #!/bin/bash
 
 g++ -o raycaster main.cpp -O1 -fno-exceptions -fno-rtti
-g++ -o bin2png bin2png.cpp -Ofast -fno-exceptions -fno-rtti -lpng
+g++ -o bin2png bin2png.cpp -Ofast -fno-exceptions -fno-rtti -pthread -lpng -lz
+g++ -o bench_compile bench_compile.cpp -O2 -fno-exceptions -fno-rtti
+g++ -o raycaster_rt runtime.cpp -O2 -ffp-contract=off -fno-exceptions -fno-rtti -pthread
+g++ -o scene2hpp scene2hpp.cpp -O2 -fno-exceptions -fno-rtti
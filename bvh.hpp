@@ -0,0 +1,215 @@
+#ifndef bvh_H__
+#define bvh_H__
+
+#include "raycast.hpp"
+
+// compile-time bounding-volume hierarchy over a voxel array -- nodes are laid out flat in depth-first order, so the
+// left child of an inner node immediately follows it, while the right child is referred to by index; leaves refer to
+// a range of the voxel array, which the builder reorders so that the voxels of each leaf are consecutive
+
+constexpr size_t bvh_leaf_size = 4;
+constexpr size_t bvh_max_depth = 64;
+
+struct BVHNode
+{
+	BBox bbox;
+	size_t first; // leaf: first voxel; inner: right child
+	size_t count; // leaf: voxel count; inner: zero
+
+	constexpr BVHNode()
+	: bbox(float3(0.f), float3(0.f))
+	, first(0)
+	, count(0)
+	{}
+};
+
+// distance at which a ray enters a bbox, negative when starting inside; MAXFLOAT if missing the bbox; a conservative
+// counterpart of intersect(BBox, Ray) -- no voxel inside the bbox is hit closer than the bbox is entered
+constexpr float enter(
+	const BBox& bbox,
+	const Ray& ray)
+{
+	const float3 t0 = (bbox.min - ray.origin) * ray.rcpdir;
+	const float3 t1 = (bbox.max - ray.origin) * ray.rcpdir;
+
+	const float3 axial_min = fmin(t0, t1);
+	const float3 axial_max = fmax(t0, t1);
+
+	const float min = fmaxf(fmaxf(axial_min.x, axial_min.y), axial_min.z);
+	const float max = fminf(fminf(axial_max.x, axial_max.y), axial_max.z);
+
+	return select(MAXFLOAT, min, isless(0.f, max) && !isless(max, min));
+}
+
+template < size_t size >
+struct BVH
+{
+	static_assert(size > 0, "empty scene");
+
+	Voxel voxel[size];
+	size_t index[size]; // position of the voxel in the source array
+	BVHNode node[2 * size - 1];
+	size_t num_nodes;
+
+	constexpr BVH(const std::array< Voxel, size >& scene)
+	: BVH(scene, std::make_index_sequence< size >())
+	{}
+
+private:
+	template < size_t... i >
+	constexpr BVH(const std::array< Voxel, size >& scene, std::index_sequence< i... >)
+	: voxel{ scene[i]... }
+	, index{ i... }
+	, node{}
+	, num_nodes(0)
+	{
+		build(0, size);
+	}
+
+	// doubled voxel centre along an axis; ties are broken by source position, for a deterministic build
+	constexpr float centre(size_t i, int axis) const
+	{
+		return axis == 0 ? voxel[i].min.x + voxel[i].max.x :
+		       axis == 1 ? voxel[i].min.y + voxel[i].max.y :
+		                   voxel[i].min.z + voxel[i].max.z;
+	}
+
+	constexpr bool less(size_t a, size_t b, int axis) const
+	{
+		return centre(a, axis) < centre(b, axis) || (centre(a, axis) == centre(b, axis) && index[a] < index[b]);
+	}
+
+	constexpr void swap(size_t a, size_t b)
+	{
+		const Voxel v = voxel[a];
+		const size_t i = index[a];
+		voxel[a] = voxel[b];
+		index[a] = index[b];
+		voxel[b] = v;
+		index[b] = i;
+	}
+
+	// quickselect -- reorder [first, last) so that nth holds the voxel it would hold if the range were sorted along
+	// axis, with no greater voxel before it and no lesser voxel after it
+	constexpr void selectNth(size_t first, size_t last, size_t nth, int axis)
+	{
+		while (last - first > 1) {
+			swap(first + (last - first) / 2, last - 1);
+
+			size_t pivot = first;
+
+			for (size_t i = first; i < last - 1; ++i)
+				if (less(i, last - 1, axis))
+					swap(i, pivot++);
+
+			swap(pivot, last - 1);
+
+			if (nth == pivot)
+				return;
+
+			if (nth < pivot)
+				last = pivot;
+			else
+				first = pivot + 1;
+		}
+	}
+
+	// median split along the longest axis of the voxel centres; returns the index of the subtree root
+	constexpr size_t build(size_t first, size_t count)
+	{
+		const size_t n = num_nodes++;
+		node[n].bbox = computeSceneBBox(&voxel[first], count);
+
+		if (count <= bvh_leaf_size) {
+			node[n].first = first;
+			node[n].count = count;
+			return n;
+		}
+
+		float3 centre_min(+MAXFLOAT);
+		float3 centre_max(-MAXFLOAT);
+
+		for (size_t i = first; i < first + count; ++i) {
+			const float3 c = voxel[i].min + voxel[i].max;
+			centre_min = fmin(centre_min, c);
+			centre_max = fmax(centre_max, c);
+		}
+
+		const float3 span = centre_max - centre_min;
+		const int axis = span.x >= span.y && span.x >= span.z ? 0 : span.y >= span.z ? 1 : 2;
+
+		selectNth(first, first + count, first + count / 2, axis);
+
+		build(first, count / 2);
+		node[n].first = build(first + count / 2, count - count / 2);
+		node[n].count = 0;
+		return n;
+	}
+};
+
+// closest hit over the voxels of a BVH -- same as the closest hit over the source voxel array, ties included: of
+// equidistant hits the voxel first in the source array prevails; children are visited near-first, and subtrees
+// entered farther than the closest hit so far are culled
+template < size_t size >
+constexpr Hit intersect(
+	const BVH< size >& bvh,
+	const Ray& ray)
+{
+	Hit closest;
+	size_t closest_index = size;
+
+	size_t stack[bvh_max_depth] = {};
+	float stack_enter[bvh_max_depth] = {};
+	size_t depth = 0;
+	size_t n = 0;
+
+	if (MAXFLOAT == enter(bvh.node[0].bbox, ray))
+		return closest;
+
+	while (true) {
+		const BVHNode& node = bvh.node[n];
+
+		if (node.count) {
+			for (size_t i = node.first; i < node.first + node.count; ++i) {
+				const Hit hit = intersect(bvh.voxel[i], ray);
+
+				if (hit.dist < closest.dist || (MAXFLOAT != hit.dist && hit.dist == closest.dist && bvh.index[i] < closest_index)) {
+					closest = hit;
+					closest_index = bvh.index[i];
+				}
+			}
+		}
+		else {
+			const size_t l = n + 1;
+			const size_t r = node.first;
+			const float enter_l = enter(bvh.node[l].bbox, ray);
+			const float enter_r = enter(bvh.node[r].bbox, ray);
+			const bool visit_l = MAXFLOAT != enter_l && enter_l <= closest.dist;
+			const bool visit_r = MAXFLOAT != enter_r && enter_r <= closest.dist;
+
+			if (visit_l && visit_r) {
+				const bool near_l = enter_l <= enter_r;
+				stack[depth] = near_l ? r : l;
+				stack_enter[depth++] = near_l ? enter_r : enter_l;
+				n = near_l ? l : r;
+				continue;
+			}
+
+			if (visit_l || visit_r) {
+				n = visit_l ? l : r;
+				continue;
+			}
+		}
+
+		// pop the next subtree still entered no farther than the closest hit
+		do {
+			if (0 == depth)
+				return closest;
+
+			n = stack[--depth];
+		}
+		while (stack_enter[depth] > closest.dist);
+	}
+}
+
+#endif // bvh_H__
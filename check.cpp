@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "raycast.hpp"
+#include "scene.hpp"
+#include "render.hpp"
+#include "packet.hpp"
+#include "soa.hpp"
+#include "stream.hpp"
+
+// verify iostream-free status
+#if _GLIBCXX_IOSTREAM
+#error rogue iostream acquired
+#endif
+
+namespace stream {
+
+// deferred initialization by main()
+in cin;
+out cout;
+out cerr;
+
+} // namespace stream
+
+// bit-exactness check of the origin-relative traversals -- boxes translated by the ray origin, tested by
+// intersectRelative, the relative packet and SoA kernels, and rendered through RelativeVoxelList / RelativeVoxelSoA,
+// must hit exactly as the boxes as they are, tested by intersect; over random rays and boxes, and random cameras,
+// inside the scene among them; run by check.sh
+
+// xorshift64, for a sequence independent of the C library
+class Random
+{
+	uint64_t state;
+
+public:
+	Random(uint64_t seed)
+	: state(seed)
+	{}
+
+	uint64_t next()
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	// uniform in [a, b)
+	float uniform(float a, float b)
+	{
+		return a + (b - a) * float(next() >> 40) * (1.f / (1 << 24));
+	}
+
+	float3 uniform3(float a, float b)
+	{
+		const float x = uniform(a, b);
+		const float y = uniform(a, b);
+		const float z = uniform(a, b);
+		return float3(x, y, z);
+	}
+};
+
+static bool sameHit(const Hit& a, const Hit& b)
+{
+	return 0 == memcmp(&a.dist, &b.dist, sizeof(a.dist)) && a.a_mask == b.a_mask && a.b_mask == b.b_mask;
+}
+
+static Voxel translated(const Voxel& voxel, const float3& origin)
+{
+	return Voxel(voxel.min - origin, voxel.max - origin);
+}
+
+// random box, occasionally flat along an axis, or a NaN box as pads the SoA arrays
+static Voxel randomVoxel(Random& random)
+{
+	if (0 == random.next() % 64)
+		return Voxel(float3(__builtin_nanf("")), float3(__builtin_nanf("")));
+
+	const float3 min = random.uniform3(-1.f, 1.f);
+	float3 max = min + random.uniform3(0.f, .5f);
+
+	if (0 == random.next() % 16)
+		max.y = min.y;
+
+	return Voxel(min, max);
+}
+
+// random ray, its direction occasionally along an axis, clamped as by primaryRay
+static Ray randomRay(Random& random, const float3& origin)
+{
+	float3 dir = random.uniform3(-1.f, 1.f);
+
+	if (0 == random.next() % 16)
+		dir.x = 0.f;
+
+	if (0 == random.next() % 16)
+		dir.z = 0.f;
+
+	return Ray{ origin, clamp(dir.rcp(), -MAXFLOAT / 2, MAXFLOAT / 2) };
+}
+
+static size_t checkRays(Random& random, const size_t count)
+{
+	size_t failures = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		const float3 origin = random.uniform3(-2.f, 2.f);
+		const Voxel voxel = randomVoxel(random);
+		const Ray ray = randomRay(random, origin);
+
+		if (!sameHit(intersect(voxel, ray), intersectRelative(translated(voxel, origin), ray.rcpdir)))
+			++failures;
+	}
+
+	return failures;
+}
+
+// packets of rays sharing an origin, wider than the vector unit for the scalar lanes
+static size_t checkPackets(Random& random, const size_t count)
+{
+	const size_t lanes = packet_simd + 3;
+	size_t failures = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		const float3 origin = random.uniform3(-2.f, 2.f);
+		std::vector< Voxel > voxels, relative;
+
+		for (size_t j = 0, n = 1 + random.next() % 64; j < n; ++j) {
+			voxels.push_back(randomVoxel(random));
+			relative.push_back(translated(voxels.back(), origin));
+		}
+
+		RayPacket< lanes > packet;
+
+		for (size_t lane = 0; lane < lanes; ++lane)
+			packet.set(lane, randomRay(random, origin));
+
+		const HitPacket< lanes > hit = intersect(voxels.data(), voxels.size(), packet);
+		const HitPacket< lanes > hit_relative = intersectRelative(relative.data(), relative.size(), packet);
+
+		for (size_t lane = 0; lane < lanes; ++lane)
+			if (!sameHit(hit.get(lane), hit_relative.get(lane)))
+				++failures;
+	}
+
+	return failures;
+}
+
+// renders of random scenes and cameras, through the voxel list and the SoA, as they are and relative to the camera
+static size_t checkRenders(Random& random, const size_t count)
+{
+	size_t failures = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		std::vector< Voxel > voxels;
+
+		if (i & 1)
+			for (size_t j = 0, n = 1 + random.next() % 2048; j < n; ++j)
+				voxels.push_back(latticeVoxel(j, n));
+		else
+			for (size_t j = 0, n = 1 + random.next() % 256; j < n; ++j)
+				voxels.push_back(randomVoxel(random));
+
+		// camera outside the scene, or at a point within its bbox
+		const BBox bbox = computeSceneBBox(voxels.data(), voxels.size());
+		const float3 inside = bbox.min + (bbox.max - bbox.min) * random.uniform3(0.f, 1.f);
+		const float3 pos = i % 3 ? cam_pos : inside;
+
+		const int w = 1 + int(random.next() % 96);
+		const int h = 1 + int(random.next() % 64);
+		const matx4 mv_inv = viewInverse(
+			random.uniform(-.5f, .5f),
+			random.uniform(0.f, 2 * M_PI),
+			random.uniform(-1.f, 1.f),
+			pos,
+			bbox);
+		const float3 cam[] = {
+			viewCam(mv_inv, 0, w, h),
+			viewCam(mv_inv, 1, w, h),
+			viewCam(mv_inv, 2, w, h),
+			viewCam(mv_inv, 3, w, h)
+		};
+
+		const VoxelList list = { voxels.data(), voxels.size() };
+		const VoxelSoA soa(voxels.data(), voxels.size());
+		const int tile_size = 1 + int(random.next() % 16);
+
+		std::vector< Pixel > image(size_t(w) * h, Pixel(0));
+		std::vector< Pixel > image_list(size_t(w) * h, Pixel(0));
+		std::vector< Pixel > image_soa(size_t(w) * h, Pixel(0));
+
+		renderImage(w, h, cam, list, image.data(), tile_size, 1);
+		renderImage(w, h, cam, originScene(list, cam[3]), image_list.data(), tile_size, 1);
+		renderImage(w, h, cam, originScene(soa, cam[3]), image_soa.data(), tile_size, 1);
+
+		if (memcmp(image.data(), image_list.data(), image.size() * sizeof(Pixel)))
+			++failures;
+
+		if (memcmp(image.data(), image_soa.data(), image.size() * sizeof(Pixel)))
+			++failures;
+	}
+
+	return failures;
+}
+
+int main(int, char**)
+{
+	stream::cout.open(stdout);
+	stream::cerr.open(stderr);
+
+	Random random(0x9e3779b97f4a7c15);
+	size_t failures = 0;
+	size_t n;
+
+	failures += n = checkRays(random, 1 << 20);
+	stream::cout << "rays: " << uint64_t(n) << " failure(s)\n";
+
+	failures += n = checkPackets(random, 1 << 14);
+	stream::cout << "packets: " << uint64_t(n) << " failure(s)\n";
+
+	failures += n = checkRenders(random, 256);
+	stream::cout << "renders: " << uint64_t(n) << " failure(s)\n";
+
+	stream::cout.flush();
+
+	if (failures) {
+		stream::cerr << "error: origin-relative traversal differs from intersect\n";
+		return -1;
+	}
+
+	return 0;
+}
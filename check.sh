@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# bit-exactness checks, run after build.sh: the origin-relative traversals against intersect, then the runtime render
+# over every traversal against the image.bin of the compile-time render, whole files, and against one another over a
+# larger scene
+
+g++ -o check check.cpp -O2 -ffp-contract=off -fno-exceptions -fno-rtti -pthread || exit 1
+./check || exit 1
+
+./raycaster || exit 1
+
+for accel in packet soa grid svo; do
+	./raycaster_rt -accel $accel -o check_$accel.bin 2> /dev/null || exit 1
+	cmp image.bin check_$accel.bin || exit 1
+
+	./raycaster_rt -accel $accel -lattice 4096 -res 160,120 -cam 0,0,0 -o check_lattice_$accel.bin 2> /dev/null || exit 1
+	cmp check_lattice_packet.bin check_lattice_$accel.bin || exit 1
+done
+
+rm -f check_*.bin
+echo "all checks passed"
@@ -0,0 +1,203 @@
+#ifndef grid_H__
+#define grid_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "raycast.hpp"
+
+// uniform-grid voxel scene -- the scene bbox is split into cubic cells, each cell referring to the voxels overlapping it,
+// in source order; rays walk the cells they pierce front to back by a 3D-DDA (Amanatides & Woo), testing the voxels of
+// each cell with intersect(BBox, Ray), so hits and face masks are those of the voxel list; the walk ends once the next
+// cell is entered beyond the closest hit so far, so the cost of a ray depends on the distance it travels rather than
+// on the voxel count; of equidistant hits the voxel first in the source list prevails
+
+// cells are entered no farther than a hit inside them, and rays near a cell boundary walk the cell they are in, barring
+// rounding -- voxels are referred to from cells this much, relative to the cell side, beyond their bounds, and the walk
+// ends once the next cell is entered this much, relatively, beyond the closest hit
+constexpr float grid_slack = 1.f / 256;
+
+// voxels per cell the grid is sized for, absent larger voxels
+constexpr float grid_density = 1.f;
+
+class VoxelGrid
+{
+	std::vector< Voxel > voxel;
+	std::vector< uint32_t > cell_start; // per cell, start of its range of cell_voxel; one extra at the end
+	std::vector< uint32_t > cell_voxel; // voxel indices, grouped by cell
+	float3 grid_min;
+	float cell;
+	int dim[3];
+
+	// cell of a coordinate along an axis, clamped to the grid
+	int cellOf(float coord, float origin, int axis) const
+	{
+		const float c = (coord - origin) / cell;
+		return c < 0.f ? 0 : c >= dim[axis] ? dim[axis] - 1 : int(c);
+	}
+
+public:
+	VoxelGrid(const Voxel* scene, size_t count)
+	: voxel(scene, scene + count)
+	, grid_min(0.f)
+	, cell(1.f)
+	, dim{ 1, 1, 1 }
+	{
+		const BBox bbox = computeSceneBBox(scene, count);
+		grid_min = bbox.min;
+
+		if (0 == count) {
+			cell_start.assign(2, 0);
+			return;
+		}
+
+		// cell side: no smaller than the mean voxel, nor than what grid_density voxels per cell would take
+		const float3 extent = bbox.max - bbox.min;
+		double mean_size = 0;
+
+		for (size_t i = 0; i < count; ++i) {
+			const float3 size = scene[i].max - scene[i].min;
+			mean_size += fmaxf(size.x, fmaxf(size.y, size.z));
+		}
+
+		mean_size /= count;
+
+		const double volume = double(fmaxf(extent.x, 1e-30f)) * fmaxf(extent.y, 1e-30f) * fmaxf(extent.z, 1e-30f);
+		cell = fmaxf(float(mean_size), float(cbrt(volume * grid_density / count)));
+		cell = fmaxf(cell, fmaxf(extent.x, fmaxf(extent.y, extent.z)) / 1024);
+
+		dim[0] = int(extent.x / cell) + 1;
+		dim[1] = int(extent.y / cell) + 1;
+		dim[2] = int(extent.z / cell) + 1;
+
+		// counting sort of voxel references by cell; voxels near a cell boundary are referred to from both sides
+		const size_t num_cells = size_t(dim[0]) * dim[1] * dim[2];
+		const float slack = cell * grid_slack;
+		cell_start.assign(num_cells + 1, 0);
+
+		for (int pass = 0; pass < 2; ++pass) {
+			for (size_t i = 0; i < count; ++i) {
+				const int x0 = cellOf(scene[i].min.x - slack, grid_min.x, 0), x1 = cellOf(scene[i].max.x + slack, grid_min.x, 0);
+				const int y0 = cellOf(scene[i].min.y - slack, grid_min.y, 1), y1 = cellOf(scene[i].max.y + slack, grid_min.y, 1);
+				const int z0 = cellOf(scene[i].min.z - slack, grid_min.z, 2), z1 = cellOf(scene[i].max.z + slack, grid_min.z, 2);
+
+				for (int z = z0; z <= z1; ++z)
+					for (int y = y0; y <= y1; ++y)
+						for (int x = x0; x <= x1; ++x) {
+							const size_t c = (size_t(z) * dim[1] + y) * dim[0] + x;
+
+							if (0 == pass)
+								++cell_start[c + 1];
+							else
+								cell_voxel[cell_start[c]++] = uint32_t(i);
+						}
+			}
+
+			if (0 == pass) {
+				for (size_t c = 0; c < num_cells; ++c)
+					cell_start[c + 1] += cell_start[c];
+
+				cell_voxel.resize(cell_start[num_cells]);
+			}
+			else {
+				// the fill pass advanced each start to the next cell's start
+				for (size_t c = num_cells; c > 0; --c)
+					cell_start[c] = cell_start[c - 1];
+
+				cell_start[0] = 0;
+			}
+		}
+	}
+
+	size_t size() const
+	{
+		return voxel.size();
+	}
+
+	size_t num_cells() const
+	{
+		return cell_start.size() - 1;
+	}
+
+	// voxel references over cells, a measure of voxels straddling cells
+	size_t num_refs() const
+	{
+		return cell_voxel.size();
+	}
+
+	friend Hit intersect(const VoxelGrid& grid, const Ray& ray);
+};
+
+// closest hit over the voxels of a grid
+inline Hit intersect(
+	const VoxelGrid& grid,
+	const Ray& ray)
+{
+	Hit closest;
+	uint32_t closest_index = UINT32_MAX;
+
+	if (grid.voxel.empty())
+		return closest;
+
+	const float3 grid_max = grid.grid_min + float3(grid.cell) * float3(float(grid.dim[0]), float(grid.dim[1]), float(grid.dim[2]));
+
+	// clip the ray to the grid
+	const float3 t0 = (grid.grid_min - ray.origin) * ray.rcpdir;
+	const float3 t1 = (grid_max - ray.origin) * ray.rcpdir;
+	const float3 axial_min = fmin(t0, t1);
+	const float3 axial_max = fmax(t0, t1);
+	const float t_enter = fmaxf(fmaxf(fmaxf(axial_min.x, axial_min.y), axial_min.z), 0.f);
+	const float t_leave = fminf(fminf(axial_max.x, axial_max.y), axial_max.z);
+
+	if (!(t_enter <= t_leave))
+		return closest;
+
+	// cell the ray enters the grid at; the entry point is taken from the ray direction recovered from its reciprocal
+	const float3 dir = ray.rcpdir.rcp();
+	const float3 entry = ray.origin + dir * float3(t_enter);
+	const float origin[] = { grid.grid_min.x, grid.grid_min.y, grid.grid_min.z };
+	const float ray_origin[] = { ray.origin.x, ray.origin.y, ray.origin.z };
+	const float rcpdir[] = { ray.rcpdir.x, ray.rcpdir.y, ray.rcpdir.z };
+	const float pos[] = { entry.x, entry.y, entry.z };
+
+	// distances to the next cell boundary are recomputed from the boundary at each step, rather than accumulated, lest
+	// rounding errors build up over long walks
+	int idx[3];
+	int step[3];
+	float t_next[3];
+
+	for (int axis = 0; axis < 3; ++axis) {
+		idx[axis] = grid.cellOf(pos[axis], origin[axis], axis);
+		step[axis] = rcpdir[axis] < 0.f ? -1 : 1;
+		t_next[axis] = (origin[axis] + grid.cell * (idx[axis] + (step[axis] > 0)) - ray_origin[axis]) * rcpdir[axis];
+	}
+
+	while (true) {
+		const size_t c = (size_t(idx[2]) * grid.dim[1] + idx[1]) * grid.dim[0] + idx[0];
+
+		for (uint32_t i = grid.cell_start[c]; i < grid.cell_start[c + 1]; ++i) {
+			const uint32_t v = grid.cell_voxel[i];
+			const Hit hit = intersect(grid.voxel[v], ray);
+
+			if (hit.dist < closest.dist || (MAXFLOAT != hit.dist && hit.dist == closest.dist && v < closest_index)) {
+				closest = hit;
+				closest_index = v;
+			}
+		}
+
+		const int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+		const float t_exit = t_next[axis];
+
+		if (t_exit > closest.dist * (1.f + grid_slack))
+			return closest;
+
+		idx[axis] += step[axis];
+
+		if (idx[axis] < 0 || idx[axis] >= grid.dim[axis])
+			return closest;
+
+		t_next[axis] = (origin[axis] + grid.cell * (idx[axis] + (step[axis] > 0)) - ray_origin[axis]) * rcpdir[axis];
+	}
+}
+
+#endif // grid_H__
@@ -0,0 +1,256 @@
+#ifndef imagebin_H__
+#define imagebin_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include "stream.hpp"
+
+// image.bin container -- v2: a 64-byte header, then the pixel rows, each padded to a stride a multiple of 64 bytes,
+// from a file offset a multiple of 64, so that a mapped file has every row aligned; then, optionally, a tile index
+// of the file offsets of the first pixel of each tile, in raster order of tiles, so that any tile can be accessed
+// straight from the mapping; rows run bottom-up, as in v1
+//
+// v1, still read: two uint16_t dimensions, followed by packed rows
+
+enum ImageFormat
+{
+	image_format_rgb8 = 1
+};
+
+constexpr char image_magic[8] = { '\x89', 'R', 'A', 'Y', 'B', 'I', 'N', '\n' };
+constexpr uint32_t image_version = 2;
+constexpr size_t image_align = 64;
+constexpr size_t image_pixel_size = 3;
+
+struct ImageHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t format; // ImageFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride; // bytes per row
+	uint32_t tile_w; // tile side of the tile index, 0 for none
+	uint32_t tile_h;
+	uint32_t reserved0;
+	uint64_t pixels; // file offset of the first row
+	uint64_t tile_index; // file offset of the tile index, 0 for none
+	uint64_t reserved1;
+};
+
+static_assert(sizeof(ImageHeader) == image_align, "ImageHeader is not 64 bytes");
+
+inline size_t alignImage(size_t offset)
+{
+	return (offset + image_align - 1) & ~(image_align - 1);
+}
+
+// header of a v2 image of the given dimensions, and, unless tile_w or tile_h is zero, a tile index of that tile size
+inline ImageHeader imageHeader(
+	uint32_t width,
+	uint32_t height,
+	uint32_t tile_w = 0,
+	uint32_t tile_h = 0)
+{
+	ImageHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, image_magic, sizeof(header.magic));
+
+	header.version = image_version;
+	header.format = image_format_rgb8;
+	header.width = width;
+	header.height = height;
+	header.stride = uint32_t(alignImage(size_t(width) * image_pixel_size));
+	header.pixels = sizeof(header);
+
+	if (tile_w && tile_h) {
+		header.tile_w = tile_w;
+		header.tile_h = tile_h;
+		header.tile_index = alignImage(header.pixels + uint64_t(header.stride) * height);
+	}
+
+	return header;
+}
+
+inline size_t imageTileCount(const ImageHeader& header)
+{
+	if (0 == header.tile_w || 0 == header.tile_h)
+		return 0;
+
+	return size_t((uint64_t(header.width) + header.tile_w - 1) / header.tile_w) * ((uint64_t(header.height) + header.tile_h - 1) / header.tile_h);
+}
+
+inline bool writeImageHeader(
+	stream::out& f,
+	const ImageHeader& header)
+{
+	return f.write(&header, 1).is_good();
+}
+
+// count rows of packed pixels, each padded to the stride; rows and their padding go out as gathered writes, a batch
+// of rows at a time
+inline bool writeImageRows(
+	stream::out& f,
+	const ImageHeader& header,
+	const void* rows,
+	size_t count)
+{
+	static const uint8_t padding[image_align] = { 0 };
+	const size_t row_size = size_t(header.width) * image_pixel_size;
+	const size_t pad = header.stride - row_size;
+	const size_t batch = 256;
+	stream::span spans[batch * 2];
+
+	for (size_t i = 0; i < count; i += batch) {
+		const size_t n = count - i < batch ? count - i : batch;
+
+		for (size_t j = 0; j < n; ++j) {
+			spans[j * 2].data = static_cast< const uint8_t* >(rows) + (i + j) * row_size;
+			spans[j * 2].size = row_size;
+			spans[j * 2 + 1].data = padding;
+			spans[j * 2 + 1].size = pad;
+		}
+
+		if (!f.writev(spans, n * 2).is_good())
+			return false;
+	}
+
+	return true;
+}
+
+// the tile index, if any, following all rows
+inline bool writeImageTileIndex(
+	stream::out& f,
+	const ImageHeader& header)
+{
+	static const uint8_t padding[image_align] = { 0 };
+	const uint64_t rows_end = header.pixels + uint64_t(header.stride) * header.height;
+
+	if (0 == header.tile_index)
+		return true;
+
+	if (header.tile_index > rows_end)
+		f.write(padding, header.tile_index - rows_end);
+
+	for (uint32_t y = 0; y < header.height; y += header.tile_h)
+		for (uint32_t x = 0; x < header.width; x += header.tile_w) {
+			const uint64_t offset = header.pixels + uint64_t(header.stride) * y + uint64_t(x) * image_pixel_size;
+			f.write(&offset, 1);
+		}
+
+	return f.is_good();
+}
+
+// a v1 or v2 image in memory, e.g. a mapped file
+struct ImageView
+{
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tile_w; // 0 for no tile index
+	uint32_t tile_h;
+	size_t stride;
+	const uint8_t* pixels; // first row
+	const uint64_t* tile_index;
+	const uint8_t* base; // start of file
+};
+
+// validate an image file of the given length, and locate its rows and tile index
+inline bool readImage(
+	const void* data,
+	size_t length,
+	ImageView& view)
+{
+	const uint8_t* const base = static_cast< const uint8_t* >(data);
+	memset(&view, 0, sizeof(view));
+	view.base = base;
+
+	ImageHeader header;
+	memset(&header, 0, sizeof(header));
+
+	if (length >= sizeof(header))
+		memcpy(&header, base, sizeof(header));
+
+	if (!memcmp(header.magic, image_magic, sizeof(image_magic))) {
+		// file offsets are untrusted -- each is checked against the length before anything is added to it
+		if (image_version != header.version || image_format_rgb8 != header.format || 0 == header.width || 0 == header.height ||
+			header.stride < uint64_t(header.width) * image_pixel_size || header.pixels < sizeof(header) ||
+			0 != header.pixels % image_align || header.pixels > length ||
+			uint64_t(header.stride) * header.height > length - header.pixels)
+			return false;
+
+		const uint64_t rows_end = header.pixels + uint64_t(header.stride) * header.height;
+
+		if (header.tile_index && (0 == header.tile_w || 0 == header.tile_h || header.tile_index < rows_end ||
+			0 != header.tile_index % sizeof(uint64_t) || header.tile_index > length ||
+			imageTileCount(header) > (length - header.tile_index) / sizeof(uint64_t)))
+			return false;
+
+		view.version = header.version;
+		view.width = header.width;
+		view.height = header.height;
+		view.stride = header.stride;
+		view.pixels = base + header.pixels;
+
+		if (header.tile_index) {
+			view.tile_w = header.tile_w;
+			view.tile_h = header.tile_h;
+			view.tile_index = reinterpret_cast< const uint64_t* >(base + header.tile_index);
+		}
+
+		return true;
+	}
+
+	uint16_t dim[2];
+
+	if (length < sizeof(dim))
+		return false;
+
+	memcpy(dim, base, sizeof(dim));
+
+	if (0 == dim[0] || 0 == dim[1] || size_t(dim[0]) * dim[1] * image_pixel_size + sizeof(dim) != length)
+		return false;
+
+	view.version = 1;
+	view.width = dim[0];
+	view.height = dim[1];
+	view.stride = size_t(dim[0]) * image_pixel_size;
+	view.pixels = base + sizeof(dim);
+	return true;
+}
+
+// first pixel of tile (tx, ty), rows following at the stride; nil without a tile index, past the tile grid, or if
+// the tile, as clipped to the image, does not lie within the pixel rows
+inline const uint8_t* imageTile(
+	const ImageView& view,
+	uint32_t tx,
+	uint32_t ty)
+{
+	if (0 == view.tile_index)
+		return 0;
+
+	const uint64_t tiles_x = (uint64_t(view.width) + view.tile_w - 1) / view.tile_w;
+	const uint64_t tiles_y = (uint64_t(view.height) + view.tile_h - 1) / view.tile_h;
+
+	if (tx >= tiles_x || ty >= tiles_y)
+		return 0;
+
+	// offsets are as found in the file
+	const uint64_t offset = view.tile_index[ty * tiles_x + tx];
+	const uint64_t rows_begin = view.pixels - view.base;
+	const uint64_t rows_end = rows_begin + uint64_t(view.stride) * view.height;
+
+	// tiles of the last column and row are clipped by the image
+	const uint64_t tile_w = std::min(uint64_t(view.tile_w), view.width - uint64_t(tx) * view.tile_w);
+	const uint64_t tile_h = std::min(uint64_t(view.tile_h), view.height - uint64_t(ty) * view.tile_h);
+	const uint64_t tile_span = (tile_h - 1) * view.stride + tile_w * image_pixel_size;
+
+	if (offset < rows_begin || offset > rows_end || tile_span > rows_end - offset)
+		return 0;
+
+	return view.base + offset;
+}
+
+#endif // imagebin_H__
@@ -0,0 +1,373 @@
+#ifndef packet_H__
+#define packet_H__
+
+#include <stddef.h>
+#if __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "raycast.hpp"
+
+// ray packets -- N rays, stored as structure of arrays, tested against one bbox at a time; the slab test runs on the
+// widest vector unit the build targets (AVX-512: 16 lanes, AVX: 8 lanes, SSE2: 4 lanes), lanes not filling a vector
+// go through the scalar kernel; results are bit-identical to intersect(BBox, Ray) lane for lane, misses included
+
+#if __AVX512F__
+constexpr size_t packet_simd = 16;
+#elif __AVX__
+constexpr size_t packet_simd = 8;
+#elif __SSE2__
+constexpr size_t packet_simd = 4;
+#else
+constexpr size_t packet_simd = 1;
+#endif
+
+template < size_t N >
+struct alignas(64) RayPacket
+{
+	float origin_x[N];
+	float origin_y[N];
+	float origin_z[N];
+	float rcpdir_x[N];
+	float rcpdir_y[N];
+	float rcpdir_z[N];
+
+	void set(size_t lane, const Ray& ray)
+	{
+		origin_x[lane] = ray.origin.x;
+		origin_y[lane] = ray.origin.y;
+		origin_z[lane] = ray.origin.z;
+		rcpdir_x[lane] = ray.rcpdir.x;
+		rcpdir_y[lane] = ray.rcpdir.y;
+		rcpdir_z[lane] = ray.rcpdir.z;
+	}
+
+	Ray get(size_t lane) const
+	{
+		return Ray(
+			float3(origin_x[lane], origin_y[lane], origin_z[lane]),
+			float3(rcpdir_x[lane], rcpdir_y[lane], rcpdir_z[lane]));
+	}
+};
+
+template < size_t N >
+struct alignas(64) HitPacket
+{
+	float dist[N];
+	int a_mask[N];
+	int b_mask[N];
+
+	HitPacket()
+	{
+		for (size_t i = 0; i < N; ++i)
+			set(i, Hit());
+	}
+
+	void set(size_t lane, const Hit& hit)
+	{
+		dist[lane] = hit.dist;
+		a_mask[lane] = hit.a_mask;
+		b_mask[lane] = hit.b_mask;
+	}
+
+	Hit get(size_t lane) const
+	{
+		return Hit(dist[lane], a_mask[lane], b_mask[lane]);
+	}
+};
+
+// slab test of the vector of lanes at offset i; with merge, lanes closer than in hit replace those in hit, otherwise
+// all lanes are stored; with relative, the bbox is relative to the ray origins, which do not enter the test;
+// fmin/fmax follow fminf/fmaxf: of a NaN and a number, the number is returned
+#if __AVX512F__
+template < bool merge, bool relative, size_t N >
+inline void intersectLanes(
+	const BBox& bbox,
+	const RayPacket< N >& packet,
+	size_t i,
+	HitPacket< N >& hit)
+{
+	struct V {
+		static __m512 fmin(__m512 a, __m512 b)
+		{
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, b, _CMP_UNORD_Q), _mm512_min_ps(a, b), a);
+		}
+
+		static __m512 fmax(__m512 a, __m512 b)
+		{
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, b, _CMP_UNORD_Q), _mm512_max_ps(a, b), a);
+		}
+
+		// box plane relative to the ray origins
+		static __m512 plane(float a, const float* origin)
+		{
+			return relative ? _mm512_set1_ps(a) : _mm512_sub_ps(_mm512_set1_ps(a), _mm512_loadu_ps(origin));
+		}
+	};
+
+	const __m512 rcpdir_x = _mm512_loadu_ps(packet.rcpdir_x + i);
+	const __m512 rcpdir_y = _mm512_loadu_ps(packet.rcpdir_y + i);
+	const __m512 rcpdir_z = _mm512_loadu_ps(packet.rcpdir_z + i);
+
+	const __m512 t0_x = _mm512_mul_ps(V::plane(bbox.min.x, packet.origin_x + i), rcpdir_x);
+	const __m512 t0_y = _mm512_mul_ps(V::plane(bbox.min.y, packet.origin_y + i), rcpdir_y);
+	const __m512 t0_z = _mm512_mul_ps(V::plane(bbox.min.z, packet.origin_z + i), rcpdir_z);
+	const __m512 t1_x = _mm512_mul_ps(V::plane(bbox.max.x, packet.origin_x + i), rcpdir_x);
+	const __m512 t1_y = _mm512_mul_ps(V::plane(bbox.max.y, packet.origin_y + i), rcpdir_y);
+	const __m512 t1_z = _mm512_mul_ps(V::plane(bbox.max.z, packet.origin_z + i), rcpdir_z);
+
+	const __m512 axial_min_x = V::fmin(t0_x, t1_x);
+	const __m512 axial_min_y = V::fmin(t0_y, t1_y);
+	const __m512 axial_min_z = V::fmin(t0_z, t1_z);
+	const __m512 axial_max_x = V::fmax(t0_x, t1_x);
+	const __m512 axial_max_y = V::fmax(t0_y, t1_y);
+	const __m512 axial_max_z = V::fmax(t0_z, t1_z);
+
+	const __m512 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+	const __mmask16 a_mask = _mm512_cmp_ps_mask(axial_min_x, axial_min_y, _CMP_GE_OQ);
+	const __mmask16 b_mask = _mm512_cmp_ps_mask(axial_min_xy, axial_min_z, _CMP_GE_OQ);
+
+	const __m512 min = V::fmax(axial_min_xy, axial_min_z);
+	const __m512 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+	const __mmask16 hit_mask =
+		_mm512_cmp_ps_mask(_mm512_setzero_ps(), min, _CMP_LT_OQ) &
+		_mm512_cmp_ps_mask(min, max, _CMP_LT_OQ);
+	const __m512 dist = _mm512_mask_blend_ps(hit_mask, _mm512_set1_ps(MAXFLOAT), min);
+	const __m512i a = _mm512_maskz_set1_epi32(a_mask, 1);
+	const __m512i b = _mm512_maskz_set1_epi32(b_mask, 1);
+
+	if (merge) {
+		const __m512 closest = _mm512_loadu_ps(hit.dist + i);
+		const __mmask16 closer = _mm512_cmp_ps_mask(dist, closest, _CMP_LT_OQ);
+
+		_mm512_storeu_ps(hit.dist + i, _mm512_mask_blend_ps(closer, closest, dist));
+		_mm512_storeu_si512(hit.a_mask + i, _mm512_mask_blend_epi32(closer, _mm512_loadu_si512(hit.a_mask + i), a));
+		_mm512_storeu_si512(hit.b_mask + i, _mm512_mask_blend_epi32(closer, _mm512_loadu_si512(hit.b_mask + i), b));
+	}
+	else {
+		_mm512_storeu_ps(hit.dist + i, dist);
+		_mm512_storeu_si512(hit.a_mask + i, a);
+		_mm512_storeu_si512(hit.b_mask + i, b);
+	}
+}
+
+#elif __AVX__
+template < bool merge, bool relative, size_t N >
+inline void intersectLanes(
+	const BBox& bbox,
+	const RayPacket< N >& packet,
+	size_t i,
+	HitPacket< N >& hit)
+{
+	struct V {
+		static __m256 fmin(__m256 a, __m256 b)
+		{
+			return _mm256_blendv_ps(_mm256_min_ps(a, b), a, _mm256_cmp_ps(b, b, _CMP_UNORD_Q));
+		}
+
+		static __m256 fmax(__m256 a, __m256 b)
+		{
+			return _mm256_blendv_ps(_mm256_max_ps(a, b), a, _mm256_cmp_ps(b, b, _CMP_UNORD_Q));
+		}
+
+		// box plane relative to the ray origins
+		static __m256 plane(float a, const float* origin)
+		{
+			return relative ? _mm256_set1_ps(a) : _mm256_sub_ps(_mm256_set1_ps(a), _mm256_loadu_ps(origin));
+		}
+	};
+
+	const __m256 rcpdir_x = _mm256_loadu_ps(packet.rcpdir_x + i);
+	const __m256 rcpdir_y = _mm256_loadu_ps(packet.rcpdir_y + i);
+	const __m256 rcpdir_z = _mm256_loadu_ps(packet.rcpdir_z + i);
+
+	const __m256 t0_x = _mm256_mul_ps(V::plane(bbox.min.x, packet.origin_x + i), rcpdir_x);
+	const __m256 t0_y = _mm256_mul_ps(V::plane(bbox.min.y, packet.origin_y + i), rcpdir_y);
+	const __m256 t0_z = _mm256_mul_ps(V::plane(bbox.min.z, packet.origin_z + i), rcpdir_z);
+	const __m256 t1_x = _mm256_mul_ps(V::plane(bbox.max.x, packet.origin_x + i), rcpdir_x);
+	const __m256 t1_y = _mm256_mul_ps(V::plane(bbox.max.y, packet.origin_y + i), rcpdir_y);
+	const __m256 t1_z = _mm256_mul_ps(V::plane(bbox.max.z, packet.origin_z + i), rcpdir_z);
+
+	const __m256 axial_min_x = V::fmin(t0_x, t1_x);
+	const __m256 axial_min_y = V::fmin(t0_y, t1_y);
+	const __m256 axial_min_z = V::fmin(t0_z, t1_z);
+	const __m256 axial_max_x = V::fmax(t0_x, t1_x);
+	const __m256 axial_max_y = V::fmax(t0_y, t1_y);
+	const __m256 axial_max_z = V::fmax(t0_z, t1_z);
+
+	const __m256 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+	const __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(1));
+	const __m256 a = _mm256_and_ps(_mm256_cmp_ps(axial_min_x, axial_min_y, _CMP_GE_OQ), one);
+	const __m256 b = _mm256_and_ps(_mm256_cmp_ps(axial_min_xy, axial_min_z, _CMP_GE_OQ), one);
+
+	const __m256 min = V::fmax(axial_min_xy, axial_min_z);
+	const __m256 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+	const __m256 hit_mask = _mm256_and_ps(
+		_mm256_cmp_ps(_mm256_setzero_ps(), min, _CMP_LT_OQ),
+		_mm256_cmp_ps(min, max, _CMP_LT_OQ));
+	const __m256 dist = _mm256_blendv_ps(_mm256_set1_ps(MAXFLOAT), min, hit_mask);
+
+	float* const a_mask = reinterpret_cast< float* >(hit.a_mask + i);
+	float* const b_mask = reinterpret_cast< float* >(hit.b_mask + i);
+
+	if (merge) {
+		const __m256 closest = _mm256_loadu_ps(hit.dist + i);
+		const __m256 closer = _mm256_cmp_ps(dist, closest, _CMP_LT_OQ);
+
+		_mm256_storeu_ps(hit.dist + i, _mm256_blendv_ps(closest, dist, closer));
+		_mm256_storeu_ps(a_mask, _mm256_blendv_ps(_mm256_loadu_ps(a_mask), a, closer));
+		_mm256_storeu_ps(b_mask, _mm256_blendv_ps(_mm256_loadu_ps(b_mask), b, closer));
+	}
+	else {
+		_mm256_storeu_ps(hit.dist + i, dist);
+		_mm256_storeu_ps(a_mask, a);
+		_mm256_storeu_ps(b_mask, b);
+	}
+}
+
+#elif __SSE2__
+template < bool merge, bool relative, size_t N >
+inline void intersectLanes(
+	const BBox& bbox,
+	const RayPacket< N >& packet,
+	size_t i,
+	HitPacket< N >& hit)
+{
+	struct V {
+		static __m128 select(__m128 arg_else, __m128 arg_then, __m128 pred)
+		{
+			return _mm_or_ps(_mm_and_ps(pred, arg_then), _mm_andnot_ps(pred, arg_else));
+		}
+
+		static __m128 fmin(__m128 a, __m128 b)
+		{
+			return select(_mm_min_ps(a, b), a, _mm_cmpunord_ps(b, b));
+		}
+
+		static __m128 fmax(__m128 a, __m128 b)
+		{
+			return select(_mm_max_ps(a, b), a, _mm_cmpunord_ps(b, b));
+		}
+
+		// box plane relative to the ray origins
+		static __m128 plane(float a, const float* origin)
+		{
+			return relative ? _mm_set1_ps(a) : _mm_sub_ps(_mm_set1_ps(a), _mm_loadu_ps(origin));
+		}
+	};
+
+	const __m128 rcpdir_x = _mm_loadu_ps(packet.rcpdir_x + i);
+	const __m128 rcpdir_y = _mm_loadu_ps(packet.rcpdir_y + i);
+	const __m128 rcpdir_z = _mm_loadu_ps(packet.rcpdir_z + i);
+
+	const __m128 t0_x = _mm_mul_ps(V::plane(bbox.min.x, packet.origin_x + i), rcpdir_x);
+	const __m128 t0_y = _mm_mul_ps(V::plane(bbox.min.y, packet.origin_y + i), rcpdir_y);
+	const __m128 t0_z = _mm_mul_ps(V::plane(bbox.min.z, packet.origin_z + i), rcpdir_z);
+	const __m128 t1_x = _mm_mul_ps(V::plane(bbox.max.x, packet.origin_x + i), rcpdir_x);
+	const __m128 t1_y = _mm_mul_ps(V::plane(bbox.max.y, packet.origin_y + i), rcpdir_y);
+	const __m128 t1_z = _mm_mul_ps(V::plane(bbox.max.z, packet.origin_z + i), rcpdir_z);
+
+	const __m128 axial_min_x = V::fmin(t0_x, t1_x);
+	const __m128 axial_min_y = V::fmin(t0_y, t1_y);
+	const __m128 axial_min_z = V::fmin(t0_z, t1_z);
+	const __m128 axial_max_x = V::fmax(t0_x, t1_x);
+	const __m128 axial_max_y = V::fmax(t0_y, t1_y);
+	const __m128 axial_max_z = V::fmax(t0_z, t1_z);
+
+	const __m128 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+	const __m128 one = _mm_castsi128_ps(_mm_set1_epi32(1));
+	const __m128 a = _mm_and_ps(_mm_cmpge_ps(axial_min_x, axial_min_y), one);
+	const __m128 b = _mm_and_ps(_mm_cmpge_ps(axial_min_xy, axial_min_z), one);
+
+	const __m128 min = V::fmax(axial_min_xy, axial_min_z);
+	const __m128 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+	const __m128 hit_mask = _mm_and_ps(
+		_mm_cmplt_ps(_mm_setzero_ps(), min),
+		_mm_cmplt_ps(min, max));
+	const __m128 dist = V::select(_mm_set1_ps(MAXFLOAT), min, hit_mask);
+
+	float* const a_mask = reinterpret_cast< float* >(hit.a_mask + i);
+	float* const b_mask = reinterpret_cast< float* >(hit.b_mask + i);
+
+	if (merge) {
+		const __m128 closest = _mm_loadu_ps(hit.dist + i);
+		const __m128 closer = _mm_cmplt_ps(dist, closest);
+
+		_mm_storeu_ps(hit.dist + i, V::select(closest, dist, closer));
+		_mm_storeu_ps(a_mask, V::select(_mm_loadu_ps(a_mask), a, closer));
+		_mm_storeu_ps(b_mask, V::select(_mm_loadu_ps(b_mask), b, closer));
+	}
+	else {
+		_mm_storeu_ps(hit.dist + i, dist);
+		_mm_storeu_ps(a_mask, a);
+		_mm_storeu_ps(b_mask, b);
+	}
+}
+
+#endif
+template < bool merge, bool relative, size_t N >
+inline void intersectPacket(
+	const BBox& bbox,
+	const RayPacket< N >& packet,
+	HitPacket< N >& hit)
+{
+	size_t i = 0;
+
+#if __SSE2__
+	for (; i + packet_simd <= N; i += packet_simd)
+		intersectLanes< merge, relative >(bbox, packet, i, hit);
+
+#endif
+	for (; i < N; ++i) {
+		const Hit lane = relative ? intersectRelative(bbox, packet.get(i).rcpdir) : intersect(bbox, packet.get(i));
+
+		if (!merge || lane.dist < hit.dist[i])
+			hit.set(i, lane);
+	}
+}
+
+// packet counterpart of intersect(BBox, Ray)
+template < size_t N >
+inline HitPacket< N > intersect(
+	const BBox& bbox,
+	const RayPacket< N >& packet)
+{
+	HitPacket< N > hit;
+	intersectPacket< false, false >(bbox, packet, hit);
+	return hit;
+}
+
+// packet counterpart of the closest hit over a list of voxels
+template < size_t N >
+inline HitPacket< N > intersect(
+	const Voxel* scene,
+	size_t size,
+	const RayPacket< N >& packet)
+{
+	HitPacket< N > closest;
+
+	for (size_t i = 0; i < size; ++i)
+		intersectPacket< true, false >(scene[i], packet, closest);
+
+	return closest;
+}
+
+// same as above, of voxels relative to the origin of the rays, as with intersectRelative(BBox, float3)
+template < size_t N >
+inline HitPacket< N > intersectRelative(
+	const Voxel* scene,
+	size_t size,
+	const RayPacket< N >& packet)
+{
+	HitPacket< N > closest;
+
+	for (size_t i = 0; i < size; ++i)
+		intersectPacket< true, true >(scene[i], packet, closest);
+
+	return closest;
+}
+
+#endif // packet_H__
@@ -0,0 +1,480 @@
+#ifndef render_H__
+#define render_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "raycast.hpp"
+#include "packet.hpp"
+
+// runtime image integrator -- the image is split into square tiles, rendered by a pool of threads straight into the
+// final image buffer; each thread owns a deque of tiles, initially a contiguous run of the tile grid, which it works
+// through from the back, and once out of tiles steals from the front of the other threads' deques, so that threads
+// done with cheap background tiles help out with tiles costly over the scene
+
+// runtime voxel list, stored elsewhere -- e.g. a vector, or a mapped scene file
+struct VoxelList
+{
+	const Voxel* voxel;
+	size_t count;
+};
+
+// closest hit over a runtime voxel list
+inline Hit intersect(
+	const VoxelList& scene,
+	const Ray& ray)
+{
+	return intersect(scene.voxel, scene.count, ray);
+}
+
+// runtime voxel list, translated to be relative to the common origin of all rays shot at it
+struct RelativeVoxelList
+{
+	std::vector< Voxel > voxel;
+
+	RelativeVoxelList(const VoxelList& scene, const float3& origin)
+	{
+		voxel.reserve(scene.count);
+
+		for (size_t i = 0; i < scene.count; ++i)
+			voxel.push_back(Voxel(scene.voxel[i].min - origin, scene.voxel[i].max - origin));
+	}
+};
+
+// closest hit of a ray from the common origin
+inline Hit intersect(
+	const RelativeVoxelList& scene,
+	const Ray& ray)
+{
+	Hit closest;
+
+	for (size_t i = 0; i < scene.voxel.size(); ++i) {
+		const Hit hit = intersectRelative(scene.voxel[i], ray.rcpdir);
+
+		if (hit.dist < closest.dist)
+			closest = hit;
+	}
+
+	return closest;
+}
+
+// scene as traversed by rays all starting at origin, as primary rays do at the camera -- by default the scene itself;
+// scenes that can take the origin out of the per-ray slab test overload this with a copy translated by -origin, for
+// bit-identical hits; made by the caller once per scene and camera, and rendered in place of the scene, so that the
+// translation is paid once per frame rather than once per ray and voxel, or per render region
+template < typename Scene >
+const Scene& originScene(
+	const Scene& scene,
+	const float3&)
+{
+	return scene;
+}
+
+inline RelativeVoxelList originScene(
+	const VoxelList& scene,
+	const float3& origin)
+{
+	return RelativeVoxelList(scene, origin);
+}
+
+struct RenderTile
+{
+	int x;
+	int y;
+	int w;
+	int h;
+};
+
+class TileDeque
+{
+	std::mutex mutex;
+	std::deque< RenderTile > tiles;
+
+public:
+	void push(const RenderTile& tile)
+	{
+		const std::lock_guard< std::mutex > lock(mutex);
+		tiles.push_back(tile);
+	}
+
+	// owner end
+	bool pop(RenderTile& tile)
+	{
+		const std::lock_guard< std::mutex > lock(mutex);
+
+		if (tiles.empty())
+			return false;
+
+		tile = tiles.back();
+		tiles.pop_back();
+		return true;
+	}
+
+	// thief end
+	bool steal(RenderTile& tile)
+	{
+		const std::lock_guard< std::mutex > lock(mutex);
+
+		if (tiles.empty())
+			return false;
+
+		tile = tiles.front();
+		tiles.pop_front();
+		return true;
+	}
+};
+
+struct RenderStats
+{
+	size_t tiles;
+	size_t steals;
+};
+
+// count pixels of row y, starting at column x
+template < typename Scene >
+void renderSpan(
+	int x,
+	int y,
+	int count,
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const Scene& scene,
+	Pixel* const span)
+{
+	for (int i = 0; i < count; ++i)
+		span[i] = shootRay(x + i, y, image_w, image_h, cam, scene);
+}
+
+// same as above, runtime voxel lists going through ray packets as wide as the vector unit
+inline void renderSpan(
+	int x,
+	int y,
+	int count,
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const VoxelList& scene,
+	Pixel* const span)
+{
+	int i = 0;
+
+	for (; i + int(packet_simd) <= count; i += packet_simd) {
+		RayPacket< packet_simd > packet;
+
+		for (size_t lane = 0; lane < packet_simd; ++lane)
+			packet.set(lane, primaryRay(x + i + lane, y, image_w, image_h, cam));
+
+		const HitPacket< packet_simd > closest = intersect(scene.voxel, scene.count, packet);
+
+		for (size_t lane = 0; lane < packet_simd; ++lane)
+			span[i + lane] = shade(closest.get(lane));
+	}
+
+	for (; i < count; ++i)
+		span[i] = shootRay(x + i, y, image_w, image_h, cam, scene);
+}
+
+// same as above, of a voxel list relative to the camera position
+inline void renderSpan(
+	int x,
+	int y,
+	int count,
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const RelativeVoxelList& scene,
+	Pixel* const span)
+{
+	int i = 0;
+
+	for (; i + int(packet_simd) <= count; i += packet_simd) {
+		RayPacket< packet_simd > packet;
+
+		for (size_t lane = 0; lane < packet_simd; ++lane)
+			packet.set(lane, primaryRay(x + i + lane, y, image_w, image_h, cam));
+
+		const HitPacket< packet_simd > closest = intersectRelative(scene.voxel.data(), scene.voxel.size(), packet);
+
+		for (size_t lane = 0; lane < packet_simd; ++lane)
+			span[i + lane] = shade(closest.get(lane));
+	}
+
+	for (; i < count; ++i)
+		span[i] = shootRay(x + i, y, image_w, image_h, cam, scene);
+}
+
+template < typename Scene >
+void renderTile(
+	const RenderTile& tile,
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const Scene& scene,
+	Pixel* const image)
+{
+	for (int y = tile.y; y < tile.y + tile.h; ++y)
+		renderSpan(tile.x, y, tile.w, image_w, image_h, cam, scene, image + size_t(y) * image_w + tile.x);
+}
+
+// render a region of the image over num_threads threads, of which the calling thread is one, leaving the rest of the
+// image as it is; tiles never spawn further tiles, so a thread finding all deques empty is done
+template < typename Scene >
+RenderStats renderRegion(
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const Scene& scene,
+	Pixel* const image,
+	const RenderTile& region,
+	const int tile_size,
+	const int num_threads)
+{
+	const int tiles_x = (region.w + tile_size - 1) / tile_size;
+	const int tiles_y = (region.h + tile_size - 1) / tile_size;
+	const int num_tiles = tiles_x * tiles_y;
+
+	std::vector< TileDeque > deques(num_threads);
+	std::vector< size_t > steals(num_threads, 0);
+
+	for (int i = 0; i < num_tiles; ++i) {
+		const int tx = i % tiles_x;
+		const int ty = i / tiles_x;
+		const RenderTile tile = {
+			region.x + tx * tile_size,
+			region.y + ty * tile_size,
+			tx + 1 < tiles_x ? tile_size : region.w - tx * tile_size,
+			ty + 1 < tiles_y ? tile_size : region.h - ty * tile_size
+		};
+
+		deques[int64_t(i) * num_threads / num_tiles].push(tile);
+	}
+
+	const auto worker = [&](const int self) {
+		RenderTile tile;
+
+		while (true) {
+			bool found = deques[self].pop(tile);
+
+			for (int i = 1; !found && i < num_threads; ++i)
+				if ((found = deques[(self + i) % num_threads].steal(tile)))
+					++steals[self];
+
+			if (!found)
+				return;
+
+			renderTile(tile, image_w, image_h, cam, scene, image);
+		}
+	};
+
+	std::vector< std::thread > threads;
+
+	for (int i = 1; i < num_threads; ++i)
+		threads.push_back(std::thread(worker, i));
+
+	worker(0);
+
+	for (std::vector< std::thread >::iterator it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	RenderStats stats = { size_t(num_tiles), 0 };
+
+	for (int i = 0; i < num_threads; ++i)
+		stats.steals += steals[i];
+
+	return stats;
+}
+
+// render the whole image
+template < typename Scene >
+RenderStats renderImage(
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const Scene& scene,
+	Pixel* const image,
+	const int tile_size,
+	const int num_threads)
+{
+	const RenderTile region = { 0, 0, image_w, image_h };
+	return renderRegion(image_w, image_h, cam, scene, image, region, tile_size, num_threads);
+}
+
+// pixels whose primary rays may hit a box -- the bounding rectangle of the box corners, projected through the camera
+// onto the pixel grid of primaryRay, and widened by a pixel for rounding; the whole image unless all corners are in
+// front of the camera; false if the rectangle misses the image
+inline bool projectBBox(
+	const BBox& box,
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	RenderTile& rect)
+{
+	// ray direction is cam[0] * u + cam[1] * v + cam[2]; a point at offset d from the ray origin lies along the ray
+	// through (u, v) = (a / c, b / c), where (a, b, c) solves [cam[0] cam[1] cam[2]] (a, b, c) = d
+	const double m[3][3] = {
+		{ cam[0].x, cam[1].x, cam[2].x },
+		{ cam[0].y, cam[1].y, cam[2].y },
+		{ cam[0].z, cam[1].z, cam[2].z }
+	};
+	const double cof[3][3] = {
+		{ m[1][1] * m[2][2] - m[1][2] * m[2][1], m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][1] * m[1][2] - m[0][2] * m[1][1] },
+		{ m[1][2] * m[2][0] - m[1][0] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][2] * m[1][0] - m[0][0] * m[1][2] },
+		{ m[1][0] * m[2][1] - m[1][1] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1], m[0][0] * m[1][1] - m[0][1] * m[1][0] }
+	};
+	const double det = m[0][0] * cof[0][0] + m[0][1] * cof[1][0] + m[0][2] * cof[2][0];
+
+	double x_min = image_w, x_max = 0;
+	double y_min = image_h, y_max = 0;
+	bool in_front = 0 != det;
+
+	for (int i = 0; i < 8 && in_front; ++i) {
+		const double d[3] = {
+			double(i & 1 ? box.max.x : box.min.x) - cam[3].x,
+			double(i & 2 ? box.max.y : box.min.y) - cam[3].y,
+			double(i & 4 ? box.max.z : box.min.z) - cam[3].z
+		};
+		double abc[3];
+
+		for (int j = 0; j < 3; ++j)
+			abc[j] = (cof[j][0] * d[0] + cof[j][1] * d[1] + cof[j][2] * d[2]) / det;
+
+		if (!(abc[2] > 0)) {
+			in_front = false;
+			break;
+		}
+
+		// pixel (idx, idy) has u = (idx * 2 - image_w) / image_w, likewise v
+		const double x = (abc[0] / abc[2] + 1) * image_w * .5;
+		const double y = (abc[1] / abc[2] + 1) * image_h * .5;
+
+		x_min = std::min(x_min, x);
+		x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);
+		y_max = std::max(y_max, y);
+	}
+
+	if (!in_front) {
+		rect = RenderTile{ 0, 0, image_w, image_h };
+		return true;
+	}
+
+	const int x0 = int(std::min(double(image_w), std::max(0., __builtin_floor(x_min) - 1)));
+	const int y0 = int(std::min(double(image_h), std::max(0., __builtin_floor(y_min) - 1)));
+	const int x1 = int(std::min(double(image_w), std::max(0., __builtin_ceil(x_max) + 2)));
+	const int y1 = int(std::min(double(image_h), std::max(0., __builtin_ceil(y_max) + 2)));
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+	rect = RenderTile{ x0, y0, x1 - x0, y1 - y0 };
+	return true;
+}
+
+// render the image over num_threads threads, of which the calling thread is one, handing it to sink in bands of
+// tile_size rows, top to bottom, as soon as a band and those above it are done; bands are rendered into a ring of
+// ring_size band buffers, so memory is that of the ring whatever the image height; tiles are taken in raster order off
+// a shared counter rather than stolen, so that bands complete about in order, and a thread waiting for a free ring slot
+// only ever waits on bands above its own; one thread at a time hands bands to sink, the others render on
+//
+// sink is called as bool sink(const Pixel* rows, int y, int count), with count rows of image_w pixels starting at row y;
+// once it returns false, it is not called again and renderStream returns false
+template < typename Scene, typename Sink >
+bool renderStream(
+	int image_w,
+	int image_h,
+	const float3 (&cam)[4],
+	const Scene& scene,
+	const int tile_size,
+	const int num_threads,
+	const int ring_size,
+	const Sink& sink,
+	RenderStats& stats)
+{
+	const int tiles_x = (image_w + tile_size - 1) / tile_size;
+	const int tiles_y = (image_h + tile_size - 1) / tile_size;
+	const int num_tiles = tiles_x * tiles_y;
+	const size_t band_size = size_t(image_w) * tile_size;
+
+	std::vector< Pixel > ring(band_size * ring_size, Pixel(0));
+	std::vector< int > pending(ring_size, tiles_x); // per slot, tiles of its band not yet rendered
+	std::mutex mutex;
+	std::condition_variable slot_free;
+	std::atomic< int > next_tile(0);
+	int next_band = 0; // first band not handed to sink yet
+	bool handing = false; // a thread is handing bands to sink
+	bool success = true;
+
+	const auto worker = [&]() {
+		while (true) {
+			const int i = next_tile++;
+
+			if (i >= num_tiles)
+				return;
+
+			const int tx = i % tiles_x;
+			const int ty = i / tiles_x;
+			const int slot = ty % ring_size;
+			Pixel* const band = ring.data() + slot * band_size;
+			const RenderTile tile = {
+				tx * tile_size,
+				ty * tile_size,
+				tx + 1 < tiles_x ? tile_size : image_w - tx * tile_size,
+				ty + 1 < tiles_y ? tile_size : image_h - ty * tile_size
+			};
+
+			std::unique_lock< std::mutex > lock(mutex);
+			slot_free.wait(lock, [&] { return ty < next_band + ring_size; });
+			lock.unlock();
+
+			for (int y = tile.y; y < tile.y + tile.h; ++y)
+				renderSpan(tile.x, y, tile.w, image_w, image_h, cam, scene, band + size_t(y - tile.y) * image_w + tile.x);
+
+			lock.lock();
+			--pending[slot];
+
+			if (handing)
+				continue;
+
+			handing = true;
+
+			while (next_band < tiles_y && 0 == pending[next_band % ring_size]) {
+				const int done = next_band;
+				const int rows = done + 1 < tiles_y ? tile_size : image_h - done * tile_size;
+				lock.unlock();
+
+				const bool handed = !success || sink(ring.data() + (done % ring_size) * band_size, done * tile_size, rows);
+
+				lock.lock();
+				success = success && handed;
+				pending[done % ring_size] = tiles_x;
+				++next_band;
+				slot_free.notify_all();
+			}
+
+			handing = false;
+		}
+	};
+
+	std::vector< std::thread > threads;
+
+	for (int i = 1; i < num_threads; ++i)
+		threads.push_back(std::thread(worker));
+
+	worker();
+
+	for (std::vector< std::thread >::iterator it = threads.begin(); it != threads.end(); ++it)
+		it->join();
+
+	stats.tiles = size_t(num_tiles);
+	stats.steals = 0;
+	return success;
+}
+
+#endif // render_H__
@@ -0,0 +1,786 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "raycast.hpp"
+#include "scene.hpp"
+#include "render.hpp"
+#include "soa.hpp"
+#include "grid.hpp"
+#include "svo.hpp"
+#include "stream.hpp"
+#include "imagebin.hpp"
+#include "scenefile.hpp"
+
+// verify iostream-free status
+#if _GLIBCXX_IOSTREAM
+#error rogue iostream acquired
+#endif
+
+namespace stream {
+
+// deferred initialization by main()
+in cin;
+out cout;
+out cerr;
+
+} // namespace stream
+
+// runtime counterpart of the compile-time render -- the same shootRay/intersect kernel, called at runtime over a
+// resolution, camera and scene taken from the command line; absent any options, renders the baked configuration of
+// scene.hpp into an image.bin identical to that of the compile-time render
+
+static bool splitFloatList(const char* const list, float* const items, const size_t count)
+{
+	const char* it = list;
+
+	for (size_t i = 0; i < count; ++i) {
+		char* end;
+		items[i] = strtof(it, &end);
+
+		if (end == it || (i + 1 < count ? ',' : '\0') != *end)
+			return false;
+
+		it = end + 1;
+	}
+
+	return true;
+}
+
+static bool parseInt(const char* const str, int& val, const int min, const int max)
+{
+	char* end;
+	const long l = strtol(str, &end, 10);
+
+	if (end == str || '\0' != *end || min > l || max < l)
+		return false;
+
+	val = int(l);
+	return true;
+}
+
+// angle in degrees, to radians
+static bool parseAngle(const char* const str, float& val)
+{
+	float deg;
+
+	if (!splitFloatList(str, &deg, 1))
+		return false;
+
+	val = deg * (M_PI / 180);
+	return true;
+}
+
+// camera key of an animation path: roll, azimuth and declination in radians, then position
+struct CameraKey
+{
+	float angle[3];
+	float pos[3];
+};
+
+// camera keys of a text path file, six numbers per key: roll, azimuth and declination in degrees, then position
+static bool readCameraPath(const char* const filename, std::vector< CameraKey >& keys)
+{
+	stream::in in;
+
+	if (!in.open(filename))
+		return false;
+
+	while (true) {
+		CameraKey key;
+
+		// only whitespace left: done
+		in >> key.angle[0];
+
+		if (in.is_fail())
+			return in.is_good() && in.is_eof() && !keys.empty();
+
+		in >> key.angle[1] >> key.angle[2] >> key.pos[0] >> key.pos[1] >> key.pos[2];
+
+		if (in.is_fail() || !in.is_good())
+			return false;
+
+		for (size_t i = 0; i < 3; ++i)
+			key.angle[i] *= M_PI / 180;
+
+		keys.push_back(key);
+	}
+}
+
+// camera of frame i of count, linearly interpolated along the path keys
+static CameraKey pathCamera(const std::vector< CameraKey >& keys, const int i, const int count)
+{
+	const float t = 1 < count ? float(i) * (keys.size() - 1) / (count - 1) : 0.f;
+	const size_t k = std::min(size_t(t), keys.size() - 1);
+	const size_t next = std::min(k + 1, keys.size() - 1);
+	const float frac = t - k;
+	CameraKey cam;
+
+	for (size_t j = 0; j < 3; ++j) {
+		cam.angle[j] = keys[k].angle[j] + (keys[next].angle[j] - keys[k].angle[j]) * frac;
+		cam.pos[j] = keys[k].pos[j] + (keys[next].pos[j] - keys[k].pos[j]) * frac;
+	}
+
+	return cam;
+}
+
+// voxel edit of an edit script
+struct VoxelEdit
+{
+	enum Op { add, remove, move } op;
+	uint64_t index; // of remove and move
+	float voxel[6]; // of add and move: min x, y, z, then max x, y, z
+};
+
+// frames of voxel edits of a text script: add x0 y0 z0 x1 y1 z1 appends a voxel, remove i erases voxel i, move i x0
+// y0 z0 x1 y1 z1 replaces voxel i; the word frame ends the edits of a frame, as does the end of the script
+static bool readEdits(const char* const filename, std::vector< std::vector< VoxelEdit > >& frames)
+{
+	stream::in in;
+
+	if (!in.open(filename))
+		return false;
+
+	std::vector< VoxelEdit > frame;
+
+	while (true) {
+		std::string word;
+		in >> word;
+
+		// runs of whitespace read as empty words
+		if (word.empty()) {
+			if (in.is_eof())
+				break;
+
+			continue;
+		}
+
+		if ("frame" == word) {
+			frames.push_back(frame);
+			frame.clear();
+			continue;
+		}
+
+		VoxelEdit edit;
+
+		if ("add" == word)
+			edit.op = VoxelEdit::add;
+		else
+		if ("remove" == word)
+			edit.op = VoxelEdit::remove;
+		else
+		if ("move" == word)
+			edit.op = VoxelEdit::move;
+		else
+			return false;
+
+		if (VoxelEdit::add != edit.op)
+			in >> edit.index;
+
+		if (VoxelEdit::remove != edit.op)
+			in >> edit.voxel[0] >> edit.voxel[1] >> edit.voxel[2] >> edit.voxel[3] >> edit.voxel[4] >> edit.voxel[5];
+
+		if (in.is_fail() || !in.is_good())
+			return false;
+
+		frame.push_back(edit);
+	}
+
+	if (!frame.empty())
+		frames.push_back(frame);
+
+	return !frames.empty();
+}
+
+// printf-style pattern of a single int conversion, e.g. frame_%04d.bin
+static bool isFramePattern(const char* const pattern)
+{
+	int conversions = 0;
+
+	for (const char* it = pattern; '\0' != *it; ++it) {
+		if ('%' != *it)
+			continue;
+
+		if ('%' == *++it)
+			continue;
+
+		while ('0' <= *it && '9' >= *it)
+			++it;
+
+		if ('d' != *it)
+			return false;
+
+		++conversions;
+	}
+
+	return 1 == conversions;
+}
+
+static bool writeImage(
+	stream::out& f,
+	const ImageHeader& header,
+	const Pixel* const image)
+{
+	return writeImageHeader(f, header) && writeImageRows(f, header, image, header.height) && writeImageTileIndex(f, header) &&
+		(f.flush(), f.is_good());
+}
+
+int main(int argc, char** argv)
+{
+	stream::cin.open(stdin);
+	stream::cout.open(stdout);
+	stream::cerr.open(stderr);
+
+	int w = image_w;
+	int h = image_h;
+	float roll = sce_roll;
+	float azim = sce_azim;
+	float decl = sce_decl;
+	float3 pos = cam_pos;
+	std::vector< Voxel > voxels(scene.begin(), scene.end());
+	bool custom_scene = false;
+	const char* out_name = 0; // image.bin, or frame_%04d.bin of an animation or edits, unless given
+	int num_threads = std::max(1u, std::thread::hardware_concurrency());
+	int tile_size = 32;
+	bool tile_index = false;
+	bool scaling = false;
+	int ring_size = 0;
+	const char* accel = "packet";
+	const char* scene_name = 0;
+	const char* save_name = 0;
+	SceneLayout save_layout = scene_layout_packed;
+	int num_frames = 0;
+	const char* path_name = 0;
+	const char* edits_name = 0;
+
+	bool success = true;
+
+	for (int i = 1; i < argc && success; ++i) {
+		float arg[6];
+		int lattice;
+
+		if (!strcmp(argv[i], "-res") && i + 1 < argc) {
+			success = splitFloatList(argv[++i], arg, 2) &&
+				0 < arg[0] && arg[0] < INT32_MAX && arg[0] == int(arg[0]) &&
+				0 < arg[1] && arg[1] < INT32_MAX && arg[1] == int(arg[1]) &&
+				arg[0] * arg[1] <= INT32_MAX; // pixel index is an int
+			w = int(arg[0]);
+			h = int(arg[1]);
+		}
+		else
+		if (!strcmp(argv[i], "-roll") && i + 1 < argc)
+			success = parseAngle(argv[++i], roll);
+		else
+		if (!strcmp(argv[i], "-azim") && i + 1 < argc)
+			success = parseAngle(argv[++i], azim);
+		else
+		if (!strcmp(argv[i], "-decl") && i + 1 < argc)
+			success = parseAngle(argv[++i], decl);
+		else
+		if (!strcmp(argv[i], "-cam") && i + 1 < argc) {
+			success = splitFloatList(argv[++i], arg, 3);
+			pos = float3(arg[0], arg[1], arg[2]);
+		}
+		else
+		if (!strcmp(argv[i], "-voxel") && i + 1 < argc) {
+			if (!custom_scene)
+				voxels.clear();
+
+			custom_scene = true;
+			success = splitFloatList(argv[++i], arg, 6);
+			voxels.push_back(Voxel(float3(arg[0], arg[1], arg[2]), float3(arg[3], arg[4], arg[5])));
+		}
+		else
+		if (!strcmp(argv[i], "-lattice") && i + 1 < argc) {
+			if (!custom_scene)
+				voxels.clear();
+
+			custom_scene = true;
+			success = parseInt(argv[++i], lattice, 1, 1 << 24);
+
+			for (int j = 0; success && j < lattice; ++j)
+				voxels.push_back(latticeVoxel(j, lattice));
+		}
+		else
+		if (!strcmp(argv[i], "-scene") && i + 1 < argc)
+			scene_name = argv[++i];
+		else
+		if (!strcmp(argv[i], "-save-scene") && i + 1 < argc)
+			save_name = argv[++i];
+		else
+		if (!strcmp(argv[i], "-scene-layout") && i + 1 < argc) {
+			const char* const layout = argv[++i];
+			success = !strcmp(layout, "packed") || !strcmp(layout, "soa");
+			save_layout = strcmp(layout, "soa") ? scene_layout_packed : scene_layout_soa;
+		}
+		else
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			success = parseInt(argv[++i], num_frames, 1, INT32_MAX);
+		else
+		if (!strcmp(argv[i], "-path") && i + 1 < argc)
+			path_name = argv[++i];
+		else
+		if (!strcmp(argv[i], "-edits") && i + 1 < argc)
+			edits_name = argv[++i];
+		else
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			out_name = argv[++i];
+		else
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			success = parseInt(argv[++i], num_threads, 1, 1024);
+		else
+		if (!strcmp(argv[i], "-tile") && i + 1 < argc)
+			success = parseInt(argv[++i], tile_size, 1, UINT16_MAX);
+		else
+		if (!strcmp(argv[i], "-tile-index"))
+			tile_index = true;
+		else
+		if (!strcmp(argv[i], "-scaling"))
+			scaling = true;
+		else
+		if (!strcmp(argv[i], "-stream") && i + 1 < argc)
+			success = parseInt(argv[++i], ring_size, 1, UINT16_MAX);
+		else
+		if (!strcmp(argv[i], "-accel") && i + 1 < argc)
+			success = !strcmp(accel = argv[++i], "packet") || !strcmp(accel, "soa") || !strcmp(accel, "grid") || !strcmp(accel, "svo");
+		else
+			success = false;
+	}
+
+	// options at odds with one another, over the whole command line
+	if ((scaling && ring_size) || (custom_scene && scene_name) || (scaling && num_frames) || (path_name && !num_frames) ||
+		(edits_name && (num_frames || ring_size || scaling)))
+		success = false;
+
+	if (!success) {
+		stream::cerr << "usage: " << argv[0] << " [options]\n"
+			"\t-res w,h                  : image resolution (default: " << int32_t(image_w) << ',' << int32_t(image_h) << ")\n"
+			"\t-roll deg                 : camera roll, degrees (default: as baked)\n"
+			"\t-azim deg                 : camera azimuth, degrees (default: as baked)\n"
+			"\t-decl deg                 : camera declination, degrees (default: as baked)\n"
+			"\t-cam x,y,z                : camera position (default: as baked)\n"
+			"\t-voxel x0,y0,z0,x1,y1,z1  : add a voxel spanning min to max; replaces the baked scene; repeatable\n"
+			"\t-lattice n                : add n voxels laid over a cubic lattice; replaces the baked scene\n"
+			"\t-scene file               : load the scene from a text or binary scene file; replaces the baked scene;\n"
+			"\t                            excludes -voxel and -lattice\n"
+			"\t-save-scene file          : save the scene to a binary scene file\n"
+			"\t-scene-layout name        : binary scene layout, packed or soa (default: packed)\n"
+			"\t-frames n                 : render n frames of an animation, the scene and its traversal set up once; the\n"
+			"\t                            camera orbits the scene about the vertical axis, unless given a -path;\n"
+			"\t                            excludes -scaling\n"
+			"\t-path file                : camera path of the animation, from a text file of keys of six numbers each:\n"
+			"\t                            roll, azimuth and declination in degrees, then position; frames are spread\n"
+			"\t                            evenly over the keys, and interpolated linearly\n"
+			"\t-edits file               : render frames of a scene under edit, from a text script of edits: add x0 y0 z0\n"
+			"\t                            x1 y1 z1, remove i, move i x0 y0 z0 x1 y1 z1, the word frame ending the edits\n"
+			"\t                            of a frame; frame 0 is the scene before the edits, and each further frame\n"
+			"\t                            re-shoots only the pixels of the voxels its edits touch; the camera stays\n"
+			"\t                            that of frame 0; excludes -frames, -stream and -scaling\n"
+			"\t-o file                   : output file, - for stdout (default: image.bin); of an animation or edits, a\n"
+			"\t                            pattern of the frame number, as in printf %d (default: frame_%04d.bin), or -\n"
+			"\t                            for all frames one after another to stdout\n"
+			"\t-threads n                : render threads (default: hardware concurrency)\n"
+			"\t-tile n                   : tile side, pixels (default: 32)\n"
+			"\t-tile-index               : append an index of the render tiles to the image file\n"
+			"\t-scaling                  : also render over 1..n threads and print a csv of render times\n"
+			"\t-stream n                 : write bands of tile rows as they complete, through a ring of n band buffers,\n"
+			"\t                            rather than the whole image at the end; excludes -scaling\n"
+			"\t-accel name               : scene traversal (default: packet)\n"
+			"\t                            packet -- voxel list, ray packets vs one voxel at a time\n"
+			"\t                            soa    -- structure-of-arrays voxels, one ray vs a vector of voxels\n"
+			"\t                            grid   -- uniform grid of voxels, walked by 3D-DDA\n"
+			"\t                            svo    -- sparse voxel octree\n";
+		return -1;
+	}
+
+	SceneFile scene_file;
+
+	if (scene_name) {
+		timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		if (!scene_file.open(scene_name)) {
+			stream::cerr << "error: cannot load scene file '" << scene_name << "'\n";
+			return -1;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+
+		stream::cerr << "loaded " << uint64_t(scene_file.size()) << " voxel(s) from '" << scene_name << "' in " << ms << " ms\n";
+		voxels.clear();
+	}
+
+	// a SoA scene file is traversed in place by the SoA traversal; anything else takes a voxel list -- that of a packed
+	// scene file in place, or one unpacked from the SoA arrays
+	const bool soa_in_place = scene_file.is_soa() && !strcmp(accel, "soa");
+	const VoxelSoA file_soa(scene_file.arrays(), scene_file.size(), scene_file.stride());
+
+	if (scene_file.is_soa() && (!soa_in_place || save_name || edits_name))
+		for (size_t i = 0; i < file_soa.size(); ++i)
+			voxels.push_back(file_soa.get(i));
+
+	const VoxelList list = {
+		scene_name && !scene_file.is_soa() ? scene_file.data() : voxels.data(),
+		scene_name && !scene_file.is_soa() ? scene_file.size() : voxels.size()
+	};
+	const size_t scene_size = soa_in_place ? file_soa.size() : list.count;
+
+	if (save_name) {
+		stream::out f;
+
+		if (!f.open(save_name, false) || !writeScene(f, list.voxel, list.count, save_layout) || (f.flush(), !f.is_good())) {
+			stream::cerr << "error: failure writing scene file '" << save_name << "'\n";
+			return -1;
+		}
+	}
+
+	const BBox bbox = soa_in_place ? file_soa.bbox() : computeSceneBBox(list.voxel, list.count);
+	const matx4 mv_inv = viewInverse(roll, azim, decl, pos, bbox);
+	const float3 cam[] = {
+		viewCam(mv_inv, 0, w, h),
+		viewCam(mv_inv, 1, w, h),
+		viewCam(mv_inv, 2, w, h),
+		viewCam(mv_inv, 3, w, h)
+	};
+
+	std::vector< CameraKey > path;
+
+	if (path_name && !readCameraPath(path_name, path)) {
+		stream::cerr << "error: cannot load camera path '" << path_name << "'\n";
+		return -1;
+	}
+
+	std::vector< std::vector< VoxelEdit > > edits;
+
+	if (edits_name && !readEdits(edits_name, edits)) {
+		stream::cerr << "error: cannot load edit script '" << edits_name << "'\n";
+		return -1;
+	}
+
+	const VoxelSoA built_soa(list.voxel, strcmp(accel, "soa") || soa_in_place ? 0 : list.count);
+	const VoxelSoA& voxels_soa = soa_in_place ? file_soa : built_soa;
+	const VoxelGrid voxels_grid(list.voxel, strcmp(accel, "grid") ? 0 : list.count);
+	const VoxelOctree voxels_svo(list.voxel, strcmp(accel, "svo") ? 0 : list.count);
+
+	if (!strcmp(accel, "svo"))
+		stream::cerr << "octree of " << uint64_t(voxels_svo.num_nodes()) << " nodes, " << uint64_t(voxels_svo.memory()) << " bytes\n";
+
+	if (!voxels_soa.is_valid()) {
+		stream::cerr << "error: cannot allocate scene\n";
+		return -1;
+	}
+
+	// renders over the chosen traversal; the brute-force traversals take the scene translated to the camera, once per
+	// render, except for a mapped SoA scene file, traversed in place
+	const auto render = [&](const float3 (&cam)[4], Pixel* const image, const int threads) {
+		return
+			soa_in_place ? renderImage(w, h, cam, voxels_soa, image, tile_size, threads) :
+			!strcmp(accel, "soa") ? renderImage(w, h, cam, originScene(voxels_soa, cam[3]), image, tile_size, threads) :
+			!strcmp(accel, "grid") ? renderImage(w, h, cam, voxels_grid, image, tile_size, threads) :
+			!strcmp(accel, "svo") ? renderImage(w, h, cam, voxels_svo, image, tile_size, threads) :
+			renderImage(w, h, cam, originScene(list, cam[3]), image, tile_size, threads);
+	};
+
+	const auto render_stream = [&](const float3 (&cam)[4], const auto& sink, RenderStats& stats) {
+		return
+			soa_in_place ? renderStream(w, h, cam, voxels_soa, tile_size, num_threads, ring_size, sink, stats) :
+			!strcmp(accel, "soa") ? renderStream(w, h, cam, originScene(voxels_soa, cam[3]), tile_size, num_threads, ring_size, sink, stats) :
+			!strcmp(accel, "grid") ? renderStream(w, h, cam, voxels_grid, tile_size, num_threads, ring_size, sink, stats) :
+			!strcmp(accel, "svo") ? renderStream(w, h, cam, voxels_svo, tile_size, num_threads, ring_size, sink, stats) :
+			renderStream(w, h, cam, originScene(list, cam[3]), tile_size, num_threads, ring_size, sink, stats);
+	};
+
+	// no tile index by default, for an image.bin identical to that of the compile-time render; if asked for, it follows
+	// the render tiles
+	const ImageHeader header = tile_index ? imageHeader(w, h, tile_size, tile_size) : imageHeader(w, h);
+
+	if (num_frames || edits_name) {
+		const char* const pattern = out_name ? out_name : "frame_%04d.bin";
+		const bool to_stdout = !strcmp(pattern, "-");
+
+		if (!to_stdout && !isFramePattern(pattern)) {
+			stream::cerr << "error: output '" << pattern << "' is not a pattern of the frame number\n";
+			return -1;
+		}
+
+		stream::out out;
+
+		if (to_stdout && !out.open(stdout)) {
+			stream::cerr << "error: cannot open stdout\n";
+			return -1;
+		}
+
+		// output of frame i, opened as needed
+		const auto open_frame = [&](const int i) -> stream::out& {
+			if (!to_stdout) {
+				char name[4096];
+				snprintf(name, sizeof(name), pattern, i);
+
+				if (!out.open(name, false))
+					stream::cerr << "error: cannot open output file '" << name << "'\n";
+			}
+
+			return out;
+		};
+
+		const auto frame_cam = [&](const int i, float3 (&frame)[4]) {
+			const CameraKey key = path.empty() ?
+				CameraKey{ { roll, float(azim + 2 * M_PI * i / num_frames), decl }, { pos.x, pos.y, pos.z } } :
+				pathCamera(path, i, num_frames);
+			const matx4 mv_inv = viewInverse(key.angle[0], key.angle[1], key.angle[2], float3(key.pos[0], key.pos[1], key.pos[2]), bbox);
+
+			for (int j = 0; j < 4; ++j)
+				frame[j] = viewCam(mv_inv, j, w, h);
+		};
+
+		timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		bool written = true;
+		size_t tiles = 0;
+		uint64_t reshot = 0;
+
+		if (edits_name) {
+			// frame 0 rendered in full; each further frame patches the one before it, re-shooting the pixels of the
+			// screen rectangles of the voxels its edits remove, add or move, before and after the edit
+			std::vector< Voxel > edited(list.voxel, list.voxel + list.count);
+			std::vector< Pixel > image(size_t(w) * h, Pixel(0));
+
+			tiles += render(cam, image.data(), num_threads).tiles;
+			written = writeImage(open_frame(0), header, image.data());
+			num_frames = 1;
+
+			for (size_t i = 0; i < edits.size() && written; ++i, ++num_frames) {
+				std::vector< RenderTile > dirty;
+
+				const auto mark = [&](const Voxel& voxel) {
+					RenderTile rect;
+
+					if (projectBBox(voxel, w, h, cam, rect))
+						dirty.push_back(rect);
+				};
+
+				for (const VoxelEdit& edit : edits[i]) {
+					if (VoxelEdit::add != edit.op && edit.index >= edited.size()) {
+						stream::cerr << "error: edit of voxel " << edit.index << " of " << uint64_t(edited.size()) << '\n';
+						return -1;
+					}
+
+					const Voxel voxel(
+						float3(edit.voxel[0], edit.voxel[1], edit.voxel[2]),
+						float3(edit.voxel[3], edit.voxel[4], edit.voxel[5]));
+
+					if (VoxelEdit::add != edit.op)
+						mark(edited[edit.index]);
+
+					if (VoxelEdit::remove != edit.op)
+						mark(voxel);
+
+					if (VoxelEdit::add == edit.op)
+						edited.push_back(voxel);
+					else
+					if (VoxelEdit::move == edit.op)
+						edited[edit.index] = voxel;
+					else
+						edited.erase(edited.begin() + edit.index);
+				}
+
+				// overlapping rectangles merged, until none overlap, so that no pixel is shot twice
+				for (bool merged = true; merged; ) {
+					merged = false;
+
+					for (size_t j = 0; j < dirty.size(); ++j)
+						for (size_t k = j + 1; k < dirty.size(); ++k) {
+							RenderTile& a = dirty[j];
+							const RenderTile b = dirty[k];
+
+							if (a.x >= b.x + b.w || b.x >= a.x + a.w || a.y >= b.y + b.h || b.y >= a.y + a.h)
+								continue;
+
+							const int x1 = std::max(a.x + a.w, b.x + b.w);
+							const int y1 = std::max(a.y + a.h, b.y + b.h);
+							a.x = std::min(a.x, b.x);
+							a.y = std::min(a.y, b.y);
+							a.w = x1 - a.x;
+							a.h = y1 - a.y;
+
+							dirty.erase(dirty.begin() + k--);
+							merged = true;
+						}
+				}
+
+				// only the ray shooting is incremental -- the traversal is set up anew over the whole edited scene, the
+				// grid and the octree rebuilt in full, for every edit frame; the brute-force ones are translated to the
+				// camera once, for all dirty rectangles
+				const VoxelList edited_list = { edited.data(), strcmp(accel, "packet") ? 0 : edited.size() };
+				const VoxelSoA edited_soa(edited.data(), strcmp(accel, "soa") ? 0 : edited.size());
+				const VoxelGrid edited_grid(edited.data(), strcmp(accel, "grid") ? 0 : edited.size());
+				const VoxelOctree edited_svo(edited.data(), strcmp(accel, "svo") ? 0 : edited.size());
+
+				if (!edited_soa.is_valid()) {
+					stream::cerr << "error: cannot allocate scene\n";
+					return -1;
+				}
+
+				const auto edited_list_origin = originScene(edited_list, cam[3]);
+				const auto edited_soa_origin = originScene(edited_soa, cam[3]);
+
+				for (const RenderTile& rect : dirty) {
+					tiles +=
+						!strcmp(accel, "soa") ? renderRegion(w, h, cam, edited_soa_origin, image.data(), rect, tile_size, num_threads).tiles :
+						!strcmp(accel, "grid") ? renderRegion(w, h, cam, edited_grid, image.data(), rect, tile_size, num_threads).tiles :
+						!strcmp(accel, "svo") ? renderRegion(w, h, cam, edited_svo, image.data(), rect, tile_size, num_threads).tiles :
+						renderRegion(w, h, cam, edited_list_origin, image.data(), rect, tile_size, num_threads).tiles;
+					reshot += uint64_t(rect.w) * rect.h;
+				}
+
+				written = writeImage(open_frame(int(i + 1)), header, image.data());
+			}
+		}
+		else
+		if (ring_size) {
+			// each frame streamed to its output as its bands complete
+			for (int i = 0; i < num_frames && written; ++i) {
+				float3 frame[4] = { float3(0.f), float3(0.f), float3(0.f), float3(0.f) };
+				frame_cam(i, frame);
+
+				stream::out& f = open_frame(i);
+				const auto sink = [&](const Pixel* rows, int, int count) {
+					return writeImageRows(f, header, rows, count) && (f.flush(), f.is_good());
+				};
+
+				RenderStats stats = { 0, 0 };
+				written = writeImageHeader(f, header) && render_stream(frame, sink, stats) && writeImageTileIndex(f, header) &&
+					(f.flush(), f.is_good());
+				tiles += stats.tiles;
+			}
+		}
+		else {
+			// pipelined: a frame is written out while the next one renders, into the other of two frame buffers
+			const size_t image_size = size_t(w) * h;
+			std::vector< Pixel > image[2] = {
+				std::vector< Pixel >(image_size, Pixel(0)),
+				std::vector< Pixel >(image_size, Pixel(0))
+			};
+			std::thread writer;
+			bool frame_written = true;
+
+			for (int i = 0; i < num_frames; ++i) {
+				float3 frame[4] = { float3(0.f), float3(0.f), float3(0.f), float3(0.f) };
+				frame_cam(i, frame);
+				tiles += render(frame, image[i & 1].data(), num_threads).tiles;
+
+				if (writer.joinable())
+					writer.join();
+
+				if (!(written = frame_written))
+					break;
+
+				writer = std::thread([&, i]() {
+					frame_written = writeImage(open_frame(i), header, image[i & 1].data());
+				});
+			}
+
+			if (writer.joinable())
+				writer.join();
+
+			written = written && frame_written;
+		}
+
+		out.close();
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+
+		if (!written) {
+			stream::cerr << "error: failure writing to file\n";
+			return -1;
+		}
+
+		if (edits_name) {
+			stream::cerr << "edited " << int32_t(num_frames) << " frame(s) of " << int32_t(w) << 'x' << int32_t(h) << " over " <<
+				uint64_t(scene_size) << " voxel(s), " << int32_t(num_threads) << " thread(s), " << uint64_t(tiles) << " tiles, " <<
+				reshot << " pixel(s) re-shot after frame 0, in " << ms << " ms\n";
+			return 0;
+		}
+
+		stream::cerr << "animated " << int32_t(num_frames) << " frame(s) of " << int32_t(w) << 'x' << int32_t(h) << " over " <<
+			uint64_t(scene_size) << " voxel(s), " << int32_t(num_threads) << " thread(s), " << uint64_t(tiles) << " tiles, in " <<
+			ms << " ms, " << ms / num_frames << " ms per frame\n";
+		return 0;
+	}
+
+	stream::out f;
+
+	if (!out_name)
+		out_name = "image.bin";
+
+	if (!(strcmp(out_name, "-") ? f.open(out_name, false) : f.open(stdout))) {
+		stream::cerr << "error: cannot open output file '" << out_name << "'\n";
+		return -1;
+	}
+
+	bool written = writeImageHeader(f, header);
+
+	if (ring_size) {
+		// bands go out as they complete, flushed so that a consumer down a pipe can start on them
+		const auto sink = [&](const Pixel* rows, int, int count) {
+			return writeImageRows(f, header, rows, count) && (f.flush(), f.is_good());
+		};
+
+		timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		RenderStats stats = { 0, 0 };
+		written = written && render_stream(cam, sink, stats);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+
+		stream::cerr << "streamed " << int32_t(w) << 'x' << int32_t(h) << " over " << uint64_t(scene_size) << " voxel(s), " <<
+			int32_t(num_threads) << " thread(s), " << uint64_t(stats.tiles) << " tiles, " <<
+			uint64_t(size_t(ring_size) * tile_size * w * sizeof(Pixel)) << " bytes of bands, in " << ms << " ms\n";
+	}
+	else {
+		const size_t image_size = size_t(w) * h;
+		std::vector< Pixel > image(image_size, Pixel(0));
+
+		if (scaling)
+			stream::cout << "threads,tiles,steals,render_ms\n";
+
+		for (int threads = scaling ? 1 : num_threads; threads <= num_threads; ++threads) {
+			timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			const RenderStats stats = render(cam, image.data(), threads);
+
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			const double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+
+			if (scaling) {
+				stream::cout << int32_t(threads) << ',' << uint64_t(stats.tiles) << ',' << uint64_t(stats.steals) << ',' << ms << '\n';
+				stream::cout.flush();
+			}
+			else
+				stream::cerr << "rendered " << int32_t(w) << 'x' << int32_t(h) << " over " << uint64_t(scene_size) << " voxel(s), " <<
+					int32_t(threads) << " thread(s), " << uint64_t(stats.tiles) << " tiles, " << uint64_t(stats.steals) << " stolen, in " << ms << " ms\n";
+		}
+
+		written = written && writeImageRows(f, header, image.data(), h);
+	}
+
+	written = written && writeImageTileIndex(f, header) && (f.flush(), f.is_good());
+	f.close();
+
+	if (!written) {
+		stream::cerr << "error: failure writing to file\n";
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef scene_H__
+#define scene_H__
+
+#include <type_traits>
+
+#include "raycast.hpp"
+#include "bvh.hpp"
+
+// procedural scene -- count voxels laid in order over a cubic lattice spanning [-.5, .5] on each axis; the span keeps
+// voxels within distance 2 from the camera along any axis, so that products with clamped reciprocal ray directions
+// do not overflow (overflow is not a constant expression)
+constexpr size_t latticeSide(size_t count)
+{
+	size_t side = 1;
+
+	while (side * side * side < count)
+		++side;
+
+	return side;
+}
+
+constexpr Voxel latticeVoxel(size_t index, size_t count)
+{
+	const size_t side = latticeSide(count);
+	const float cell = 1.f / side;
+	const float3 min(
+		-.5f + cell * (index % side),
+		-.5f + cell * (index / side % side),
+		-.5f + cell * (index / side / side));
+
+	return Voxel(min, min + float3(cell * .75f));
+}
+
+template < size_t count, size_t... index >
+constexpr std::array< Voxel, count > latticeScene(std::index_sequence< index... >)
+{
+	return std::array< Voxel, count >{ { latticeVoxel(index, count)... } };
+}
+
+// scene content in world space
+#if SCENE_VOXELS
+constexpr std::array< Voxel, SCENE_VOXELS > scene = latticeScene< SCENE_VOXELS >(std::make_index_sequence< SCENE_VOXELS >());
+
+#elif defined(SCENE_HEADER)
+#include SCENE_HEADER // generated by scene2hpp
+
+#else
+constexpr std::array< Voxel, 2 > scene = { {
+	Voxel(float3(-.75f, -.75f, -.75f), float3(.25f, .25f, .25f)),
+	Voxel(float3(-.25f, -.25f, -.25f), float3(.75f, .75f, .75f)),
+} };
+
+#endif
+// scene meta
+constexpr size_t scene_size = scene.size();
+constexpr BBox bbox = computeSceneBBox(&scene[0], scene_size);
+
+// scene representation traversed by the image integrator -- a BVH, unless the scene fits in a single BVH leaf;
+// SCENE_BVH set to 0 or 1 forces either choice
+#ifndef SCENE_BVH
+#define SCENE_BVH (scene_size > bvh_leaf_size)
+#endif
+typedef std::conditional< SCENE_BVH, BVH< scene_size >, std::array< Voxel, scene_size > >::type Scene;
+constexpr Scene scene_accel(scene);
+
+// camera settings in world space
+constexpr float sce_roll = M_PI_2 * .25f;
+constexpr float sce_azim = M_PI_2 * .5f;
+constexpr float sce_decl = 0;
+constexpr float3 cam_pos{ 0, 0, 2.125f };
+
+// view transform
+constexpr matx4 mv_inv = viewInverse(sce_roll, sce_azim, sce_decl, cam_pos, bbox);
+
+// view transform as expected by the image integrator (4x float3)
+#ifndef IMAGE_W
+#define IMAGE_W 256
+#endif
+#ifndef IMAGE_H
+#define IMAGE_H 256
+#endif
+constexpr int image_w = IMAGE_W;
+constexpr int image_h = IMAGE_H;
+
+constexpr float3 cam[] = {
+	viewCam(mv_inv, 0, image_w, image_h),
+	viewCam(mv_inv, 1, image_w, image_h),
+	viewCam(mv_inv, 2, image_w, image_h),
+	viewCam(mv_inv, 3, image_w, image_h)
+};
+
+#endif // scene_H__
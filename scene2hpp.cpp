@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "scenefile.hpp"
+#include "stream.hpp"
+
+// verify iostream-free status
+#if _GLIBCXX_IOSTREAM
+#error rogue iostream acquired
+#endif
+
+namespace stream {
+
+// deferred initialization by main()
+in cin;
+out cout;
+out cerr;
+
+} // namespace stream
+
+// scene-file-to-header generator for the compile-time render -- turns a text or binary scene file into a header that
+// defines the scene of scene.hpp, when built with -DSCENE_HEADER='"header"'; voxels are brace-initialised from plain
+// float literals, each the shortest that reads back exactly, rather than spelled out as constructor calls; with
+// -embed, the voxels are also written as raw little-endian floats next to the header, and compilers that support
+// #embed take those instead of the literals
+
+// shortest decimal literal that reads back as the same float, as a float literal
+static bool formatFloat(const float a, char (& literal)[32])
+{
+	if (a != a || a - a != 0) // nan or inf
+		return false;
+
+	for (int precision = 1; precision <= 9; ++precision) {
+		snprintf(literal, sizeof(literal) - 2, "%.*g", precision, a);
+
+		if (strtof(literal, 0) == a)
+			break;
+	}
+
+	if (0 == strpbrk(literal, ".e"))
+		strcat(literal, ".");
+
+	strcat(literal, "f");
+	return true;
+}
+
+// file name sans directory
+static const char* baseName(const char* const name)
+{
+	const char* const slash = strrchr(name, '/');
+	return slash ? slash + 1 : name;
+}
+
+static bool writeRaw(
+	const char* const filename,
+	const std::vector< Voxel >& voxels)
+{
+	stream::out f;
+
+	if (!f.open(filename, false))
+		return false;
+
+	for (size_t i = 0; i < voxels.size(); ++i) {
+		const Voxel& voxel = voxels[i];
+		const float v[] = { voxel.min.x, voxel.min.y, voxel.min.z, voxel.max.x, voxel.max.y, voxel.max.z };
+		f.write(v, 6, stream::little_endian);
+	}
+
+	f.flush();
+	return f.is_good();
+}
+
+static bool writeHeader(
+	const char* const filename,
+	const char* const source,
+	const char* const raw,
+	const std::vector< Voxel >& voxels)
+{
+	stream::out f;
+
+	if (!f.open(filename, false))
+		return false;
+
+	f << "// generated by scene2hpp from '" << baseName(source) << "' -- do not edit; defines the scene of scene.hpp\n"
+		"#ifndef scene_table_H__\n"
+		"#define scene_table_H__\n"
+		"\n"
+		"#define SCENE_TABLE_VOXELS " << uint64_t(voxels.size()) << "\n"
+		"\n";
+
+	if (raw)
+		f << "#if defined(__has_embed)\n"
+			"#if __has_embed(\"" << baseName(raw) << "\") == __STDC_EMBED_FOUND__\n"
+			"#define SCENE_TABLE_EMBED 1\n"
+			"#endif\n"
+			"#endif\n"
+			"\n"
+			"#if SCENE_TABLE_EMBED\n"
+			"constexpr unsigned char scene_table[] = {\n"
+			"#embed \"" << baseName(raw) << "\"\n"
+			"};\n"
+			"\n"
+			"// voxel element i, of min x, y, z, max x, y, z\n"
+			"constexpr float sceneTable(size_t i)\n"
+			"{\n"
+			"\treturn __builtin_bit_cast(float, uint32_t(scene_table[i * 4]) | uint32_t(scene_table[i * 4 + 1]) << 8 |\n"
+			"\t\tuint32_t(scene_table[i * 4 + 2]) << 16 | uint32_t(scene_table[i * 4 + 3]) << 24);\n"
+			"}\n"
+			"\n"
+			"constexpr Voxel tableVoxel(size_t index)\n"
+			"{\n"
+			"\treturn Voxel(\n"
+			"\t\tfloat3(sceneTable(index * 6 + 0), sceneTable(index * 6 + 1), sceneTable(index * 6 + 2)),\n"
+			"\t\tfloat3(sceneTable(index * 6 + 3), sceneTable(index * 6 + 4), sceneTable(index * 6 + 5)));\n"
+			"}\n"
+			"\n"
+			"template < size_t count, size_t... index >\n"
+			"constexpr std::array< Voxel, count > tableScene(std::index_sequence< index... >)\n"
+			"{\n"
+			"\treturn std::array< Voxel, count >{ { tableVoxel(index)... } };\n"
+			"}\n"
+			"\n"
+			"constexpr std::array< Voxel, SCENE_TABLE_VOXELS > scene = tableScene< SCENE_TABLE_VOXELS >(std::make_index_sequence< SCENE_TABLE_VOXELS >());\n"
+			"\n"
+			"#else\n";
+
+	// brace-initialised voxels, min then max: plain float literals, no constructor names to look up
+	f << "constexpr std::array< Voxel, SCENE_TABLE_VOXELS > scene = { {\n";
+
+	for (size_t i = 0; i < voxels.size(); ++i) {
+		const Voxel& voxel = voxels[i];
+		const float v[] = { voxel.min.x, voxel.min.y, voxel.min.z, voxel.max.x, voxel.max.y, voxel.max.z };
+		char literal[6][32];
+
+		for (size_t j = 0; j < 6; ++j)
+			if (!formatFloat(v[j], literal[j])) {
+				stream::cerr << "voxel " << uint64_t(i) << " is not finite\n";
+				return false;
+			}
+
+		f << "\t{ { " << literal[0] << ", " << literal[1] << ", " << literal[2] << " }, { " <<
+			literal[3] << ", " << literal[4] << ", " << literal[5] << " } },\n";
+	}
+
+	f << "} };\n"
+		"\n";
+
+	if (raw)
+		f << "#endif\n";
+
+	f << "#endif // scene_table_H__\n";
+	f.flush();
+	return f.is_good();
+}
+
+int main(int argc, char** argv)
+{
+	stream::cin.open(stdin);
+	stream::cout.open(stdout);
+	stream::cerr.open(stderr);
+
+	const char* inputName = 0;
+	const char* outName = "scene_gen.hpp";
+	bool embed = false;
+
+	for (int i = 1; i < argc; ++i) {
+		bool success = true;
+
+		if (!strcmp(argv[i], "-i") && i + 1 < argc)
+			inputName = argv[++i];
+		else
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			outName = argv[++i];
+		else
+		if (!strcmp(argv[i], "-embed"))
+			embed = true;
+		else
+			success = false;
+
+		if (!success) {
+			stream::cerr << "usage: " << argv[0] << " -i scene_file [options]\n"
+				"\t-i file  : input scene file, text or binary\n"
+				"\t-o file  : output header (default: scene_gen.hpp)\n"
+				"\t-embed   : also write the table as raw floats, to the header name with .hpp replaced by .raw, for\n"
+				"\t           compilers that support #embed\n";
+			return -1;
+		}
+	}
+
+	if (0 == inputName) {
+		stream::cerr << "error: no input scene file\n";
+		return -1;
+	}
+
+	SceneFile scene;
+
+	if (!scene.open(inputName)) {
+		stream::cerr << "error: cannot load scene file '" << inputName << "'\n";
+		return -1;
+	}
+
+	// an empty scene would make a header that does not build -- scene.hpp bounds the scene from &scene[0] on
+	if (0 == scene.size()) {
+		stream::cerr << "error: scene file '" << inputName << "' has no voxels\n";
+		return -1;
+	}
+
+	const VoxelSoA soa(scene.arrays(), scene.size(), scene.stride());
+	std::vector< Voxel > voxels;
+
+	for (size_t i = 0; i < scene.size(); ++i)
+		voxels.push_back(scene.is_soa() ? soa.get(i) : scene.data()[i]);
+
+	std::string raw;
+
+	if (embed) {
+		raw = outName;
+		const size_t ext = raw.rfind(".hpp");
+		raw = (std::string::npos != ext && raw.size() == ext + 4 ? raw.substr(0, ext) : raw) + ".raw";
+
+		if (!writeRaw(raw.c_str(), voxels)) {
+			stream::cerr << "error: failure writing raw table '" << raw << "'\n";
+			return -1;
+		}
+	}
+
+	if (!writeHeader(outName, inputName, embed ? raw.c_str() : 0, voxels)) {
+		stream::cerr << "error: failure writing header '" << outName << "'\n";
+		return -1;
+	}
+
+	stream::cerr << "wrote " << uint64_t(voxels.size()) << " voxel(s) to '" << outName << "'\n";
+	return 0;
+}
@@ -0,0 +1,262 @@
+#ifndef scenefile_H__
+#define scenefile_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "raycast.hpp"
+#include "soa.hpp"
+#include "scoped.hpp"
+#include "stream.hpp"
+
+// voxel scene files -- text: six numbers per voxel, min x, y, z then max x, y, z, separated by any whitespace;
+// binary: a 64-byte header, then, from a file offset a multiple of 64, either the packed voxels, or the six arrays of
+// a VoxelSoA, each padded to the SoA stride with NaN boxes; a binary file is mapped and used in place, without parsing,
+// once its offsets and SoA padding are checked
+
+enum SceneLayout
+{
+	scene_layout_packed = 1,
+	scene_layout_soa = 2
+};
+
+constexpr char scene_magic[8] = { '\x89', 'R', 'A', 'Y', 'S', 'C', 'N', '\n' };
+constexpr uint32_t scene_version = 1;
+constexpr size_t scene_align = 64;
+
+struct SceneHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t layout; // SceneLayout
+	uint64_t count; // voxels
+	uint64_t stride; // floats per array of the SoA layout, count for the packed layout
+	uint64_t voxels; // file offset of the voxel data
+	uint64_t reserved[3];
+};
+
+static_assert(sizeof(SceneHeader) == scene_align, "SceneHeader is not 64 bytes");
+static_assert(sizeof(Voxel) == sizeof(float[6]), "Voxel is not six packed floats");
+static_assert(0 == soa_pad * sizeof(float) % scene_align, "SoA arrays not aligned in the scene file");
+
+inline SceneHeader sceneHeader(
+	uint64_t count,
+	SceneLayout layout)
+{
+	SceneHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, scene_magic, sizeof(header.magic));
+
+	header.version = scene_version;
+	header.layout = layout;
+	header.count = count;
+	header.stride = scene_layout_soa == layout ? (count + soa_pad - 1) / soa_pad * soa_pad : count;
+	header.voxels = sizeof(header);
+	return header;
+}
+
+inline bool writeScene(
+	stream::out& f,
+	const Voxel* voxel,
+	size_t count,
+	SceneLayout layout)
+{
+	const SceneHeader header = sceneHeader(count, layout);
+	f.write(&header, 1);
+
+	if (scene_layout_packed == layout)
+		return f.write(voxel, count).is_good();
+
+	const float nan = __builtin_nanf("");
+	float batch[1024];
+
+	for (size_t a = 0; a < 6; ++a)
+		for (size_t i = 0; i < header.stride; ) {
+			size_t n = 0;
+
+			for (; n < sizeof(batch) / sizeof(batch[0]) && i < header.stride; ++n, ++i)
+				batch[n] = i < count ? (&voxel[i].min.x)[a] : nan;
+
+			f.write(batch, n);
+		}
+
+	return f.is_good();
+}
+
+// a scene file in memory, e.g. mapped
+struct SceneView
+{
+	uint32_t layout;
+	size_t count;
+	size_t stride;
+	const Voxel* voxel; // packed layout
+	const float* array[6]; // SoA layout: min.x, min.y, .. max.z
+};
+
+// validate a binary scene file of the given length, and locate its voxels
+inline bool readScene(
+	const void* data,
+	size_t length,
+	SceneView& view)
+{
+	const uint8_t* const base = static_cast< const uint8_t* >(data);
+	memset(&view, 0, sizeof(view));
+
+	SceneHeader header;
+
+	if (length < sizeof(header))
+		return false;
+
+	memcpy(&header, base, sizeof(header));
+
+	// file offsets are untrusted -- checked against the length before anything is added to them; count is bounded by
+	// the length, so the array sizes below do not overflow
+	if (memcmp(header.magic, scene_magic, sizeof(scene_magic)) || scene_version != header.version ||
+		header.voxels < sizeof(header) || 0 != header.voxels % scene_align || header.voxels > length || header.count > length)
+		return false;
+
+	if (scene_layout_packed == header.layout) {
+		if (header.stride != header.count || header.count * sizeof(Voxel) > length - header.voxels)
+			return false;
+
+		view.voxel = reinterpret_cast< const Voxel* >(base + header.voxels);
+	}
+	else
+	if (scene_layout_soa == header.layout) {
+		if (header.stride != (header.count + soa_pad - 1) / soa_pad * soa_pad || header.stride * sizeof(float[6]) > length - header.voxels)
+			return false;
+
+		for (size_t a = 0; a < 6; ++a)
+			view.array[a] = reinterpret_cast< const float* >(base + header.voxels) + header.stride * a;
+
+		// the arrays are traversed in place, padding lanes and all -- padding other than NaN boxes would be hit
+		for (size_t a = 0; a < 6; ++a)
+			for (size_t i = header.count; i < header.stride; ++i)
+				if (!__builtin_isnan(view.array[a][i]))
+					return false;
+	}
+	else
+		return false;
+
+	view.layout = header.layout;
+	view.count = header.count;
+	view.stride = header.stride;
+	return true;
+}
+
+// append the voxels of a text scene file
+inline bool readSceneText(
+	const stream::in& in,
+	std::vector< Voxel >& voxels)
+{
+	while (true) {
+		float v[6];
+
+		// only whitespace left: done
+		in >> v[0];
+
+		if (in.is_fail())
+			return in.is_good() && in.is_eof();
+
+		in >> v[1] >> v[2] >> v[3] >> v[4] >> v[5];
+
+		if (in.is_fail() || !in.is_good())
+			return false;
+
+		voxels.push_back(Voxel(float3(v[0], v[1], v[2]), float3(v[3], v[4], v[5])));
+	}
+}
+
+// scene file of either form -- binary files are mapped and their voxels used in place; text files are parsed into
+// a voxel list; voxels are either packed or SoA, as stored
+class SceneFile : testbed::non_copyable
+{
+	void* map;
+	size_t length;
+	SceneView view;
+	std::vector< Voxel > parsed;
+
+public:
+	SceneFile()
+	: map(MAP_FAILED)
+	, length(0)
+	{
+		memset(&view, 0, sizeof(view));
+	}
+
+	~SceneFile()
+	{
+		if (MAP_FAILED != map)
+			munmap(map, length);
+	}
+
+	bool open(const char* filename)
+	{
+		const int fd = ::open(filename, O_RDONLY);
+
+		if (-1 == fd)
+			return false;
+
+		struct stat st;
+
+		if (0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size >= off_t(sizeof(SceneHeader))) {
+			length = size_t(st.st_size);
+			map = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+
+		close(fd);
+
+		if (MAP_FAILED != map) {
+			if (!memcmp(map, scene_magic, sizeof(scene_magic)))
+				return readScene(map, length, view);
+
+			munmap(map, length);
+			map = MAP_FAILED;
+		}
+
+		stream::in in;
+
+		if (!in.open(filename) || !readSceneText(in, parsed))
+			return false;
+
+		view.layout = scene_layout_packed;
+		view.count = parsed.size();
+		view.stride = parsed.size();
+		view.voxel = parsed.data();
+		return true;
+	}
+
+	bool is_soa() const
+	{
+		return scene_layout_soa == view.layout;
+	}
+
+	size_t size() const
+	{
+		return view.count;
+	}
+
+	size_t stride() const
+	{
+		return view.stride;
+	}
+
+	// packed layout
+	const Voxel* data() const
+	{
+		return view.voxel;
+	}
+
+	// SoA layout
+	const float* const (&arrays() const)[6]
+	{
+		return view.array;
+	}
+};
+
+#endif // scenefile_H__
@@ -0,0 +1,492 @@
+#ifndef soa_H__
+#define soa_H__
+
+#include <stdlib.h>
+#include <stdint.h>
+#if __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "raycast.hpp"
+#include "scoped.hpp"
+
+// structure-of-arrays voxel storage -- min.x, min.y, .. max.z of all voxels in separate arrays, aligned to a cache line
+// and padded to a multiple of the widest vector; padding voxels are NaN boxes, which no ray hits; one ray is tested
+// against a full vector of voxels per iteration, lanes keeping their closest hit by vector blends, and the lanes are
+// reduced to the closest hit at the end; the result is bit-identical to the closest hit over the source voxel list,
+// ties included: of equidistant hits the voxel first in the list prevails
+
+constexpr size_t soa_align = 64; // bytes
+constexpr size_t soa_pad = 16; // voxels
+
+class VoxelSoA : testbed::non_copyable
+{
+	float* buffer;
+	size_t count;
+	size_t stride;
+
+public:
+	const float* min_x;
+	const float* min_y;
+	const float* min_z;
+	const float* max_x;
+	const float* max_y;
+	const float* max_z;
+
+	// check is_valid() for allocation failure
+	VoxelSoA(const Voxel* voxel, size_t count)
+	: buffer(0)
+	, count(count)
+	, stride((count + soa_pad - 1) / soa_pad * soa_pad)
+	, min_x(0)
+	{
+		void* ptr;
+
+		if (0 != posix_memalign(&ptr, soa_align, sizeof(float[6]) * (stride ? stride : soa_pad)))
+			return;
+
+		buffer = reinterpret_cast< float* >(ptr);
+
+		float* const array[] = {
+			buffer + stride * 0,
+			buffer + stride * 1,
+			buffer + stride * 2,
+			buffer + stride * 3,
+			buffer + stride * 4,
+			buffer + stride * 5
+		};
+
+		for (size_t i = 0; i < stride; ++i) {
+			const Voxel box = i < count ? voxel[i] : Voxel(float3(__builtin_nanf("")), float3(__builtin_nanf("")));
+			array[0][i] = box.min.x;
+			array[1][i] = box.min.y;
+			array[2][i] = box.min.z;
+			array[3][i] = box.max.x;
+			array[4][i] = box.max.y;
+			array[5][i] = box.max.z;
+		}
+
+		min_x = array[0];
+		min_y = array[1];
+		min_z = array[2];
+		max_x = array[3];
+		max_y = array[4];
+		max_z = array[5];
+	}
+
+	// over arrays laid out as above, owned elsewhere -- e.g. a mapped scene file; stride is count padded to soa_pad
+	VoxelSoA(const float* const (&array)[6], size_t count, size_t stride)
+	: buffer(0)
+	, count(count)
+	, stride(stride)
+	, min_x(array[0])
+	, min_y(array[1])
+	, min_z(array[2])
+	, max_x(array[3])
+	, max_y(array[4])
+	, max_z(array[5])
+	{}
+
+	// translated by -origin, e.g. to be relative to the common origin of the rays shot at it; check is_valid() for
+	// allocation failure
+	VoxelSoA(const VoxelSoA& scene, const float3& origin)
+	: buffer(0)
+	, count(scene.count)
+	, stride(scene.stride)
+	, min_x(0)
+	{
+		void* ptr;
+
+		if (0 != posix_memalign(&ptr, soa_align, sizeof(float[6]) * (stride ? stride : soa_pad)))
+			return;
+
+		buffer = reinterpret_cast< float* >(ptr);
+
+		const float* const source[] = { scene.min_x, scene.min_y, scene.min_z, scene.max_x, scene.max_y, scene.max_z };
+		const float offset[] = { origin.x, origin.y, origin.z, origin.x, origin.y, origin.z };
+
+		// padding stays NaN
+		for (size_t a = 0; a < 6; ++a)
+			for (size_t i = 0; i < stride; ++i)
+				buffer[stride * a + i] = source[a][i] - offset[a];
+
+		min_x = buffer + stride * 0;
+		min_y = buffer + stride * 1;
+		min_z = buffer + stride * 2;
+		max_x = buffer + stride * 3;
+		max_y = buffer + stride * 4;
+		max_z = buffer + stride * 5;
+	}
+
+	~VoxelSoA()
+	{
+		free(buffer);
+	}
+
+	bool is_valid() const
+	{
+		return 0 != min_x;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	// voxel count padded to the widest vector
+	size_t padded_size() const
+	{
+		return stride;
+	}
+
+	Voxel get(size_t i) const
+	{
+		return Voxel(float3(min_x[i], min_y[i], min_z[i]), float3(max_x[i], max_y[i], max_z[i]));
+	}
+
+	// as computeSceneBBox over the voxel list
+	BBox bbox() const
+	{
+		float3 bbox_min{ +MAXFLOAT, +MAXFLOAT, +MAXFLOAT };
+		float3 bbox_max{ -MAXFLOAT, -MAXFLOAT, -MAXFLOAT };
+
+		for (size_t i = 0; i < count; ++i) {
+			bbox_min = fmin(bbox_min, float3(min_x[i], min_y[i], min_z[i]));
+			bbox_max = fmax(bbox_max, float3(max_x[i], max_y[i], max_z[i]));
+		}
+
+		return BBox(bbox_min, bbox_max);
+	}
+};
+
+// closest of per-lane closest hits; of equidistant hits the lowest voxel index prevails
+inline Hit reduceLanes(
+	const float* dist,
+	const int32_t* a_mask,
+	const int32_t* b_mask,
+	const int32_t* index,
+	size_t lanes)
+{
+	Hit closest;
+	int32_t closest_index = INT32_MAX;
+
+	for (size_t i = 0; i < lanes; ++i) {
+		if (dist[i] < closest.dist || (MAXFLOAT != dist[i] && dist[i] == closest.dist && index[i] < closest_index)) {
+			closest = Hit(dist[i], a_mask[i], b_mask[i]);
+			closest_index = index[i];
+		}
+	}
+
+	return closest;
+}
+
+// closest hit over the voxels of a structure-of-arrays scene; with relative, the voxels are relative to the ray
+// origin, which does not enter the test; vector min/max follow fminf/fmaxf: of a NaN and a number, the number is
+// returned
+template < bool relative >
+inline Hit intersectArrays(
+	const VoxelSoA& scene,
+	const Ray& ray)
+{
+#if __AVX512F__
+	struct V {
+		static __m512 fmin(__m512 a, __m512 b)
+		{
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, b, _CMP_UNORD_Q), _mm512_min_ps(a, b), a);
+		}
+
+		static __m512 fmax(__m512 a, __m512 b)
+		{
+			return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(b, b, _CMP_UNORD_Q), _mm512_max_ps(a, b), a);
+		}
+
+		// voxel planes relative to the ray origin
+		static __m512 plane(const float* a, __m512 origin)
+		{
+			return relative ? _mm512_load_ps(a) : _mm512_sub_ps(_mm512_load_ps(a), origin);
+		}
+	};
+
+	const __m512 origin_x = _mm512_set1_ps(ray.origin.x);
+	const __m512 origin_y = _mm512_set1_ps(ray.origin.y);
+	const __m512 origin_z = _mm512_set1_ps(ray.origin.z);
+	const __m512 rcpdir_x = _mm512_set1_ps(ray.rcpdir.x);
+	const __m512 rcpdir_y = _mm512_set1_ps(ray.rcpdir.y);
+	const __m512 rcpdir_z = _mm512_set1_ps(ray.rcpdir.z);
+
+	__m512 closest = _mm512_set1_ps(MAXFLOAT);
+	__m512i closest_a = _mm512_setzero_si512();
+	__m512i closest_b = _mm512_setzero_si512();
+	__m512i closest_index = _mm512_setzero_si512();
+	__m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	for (size_t i = 0; i < scene.padded_size(); i += 16) {
+		const __m512 t0_x = _mm512_mul_ps(V::plane(scene.min_x + i, origin_x), rcpdir_x);
+		const __m512 t0_y = _mm512_mul_ps(V::plane(scene.min_y + i, origin_y), rcpdir_y);
+		const __m512 t0_z = _mm512_mul_ps(V::plane(scene.min_z + i, origin_z), rcpdir_z);
+		const __m512 t1_x = _mm512_mul_ps(V::plane(scene.max_x + i, origin_x), rcpdir_x);
+		const __m512 t1_y = _mm512_mul_ps(V::plane(scene.max_y + i, origin_y), rcpdir_y);
+		const __m512 t1_z = _mm512_mul_ps(V::plane(scene.max_z + i, origin_z), rcpdir_z);
+
+		const __m512 axial_min_x = V::fmin(t0_x, t1_x);
+		const __m512 axial_min_y = V::fmin(t0_y, t1_y);
+		const __m512 axial_min_z = V::fmin(t0_z, t1_z);
+		const __m512 axial_max_x = V::fmax(t0_x, t1_x);
+		const __m512 axial_max_y = V::fmax(t0_y, t1_y);
+		const __m512 axial_max_z = V::fmax(t0_z, t1_z);
+
+		const __m512 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+		const __mmask16 a_mask = _mm512_cmp_ps_mask(axial_min_x, axial_min_y, _CMP_GE_OQ);
+		const __mmask16 b_mask = _mm512_cmp_ps_mask(axial_min_xy, axial_min_z, _CMP_GE_OQ);
+
+		const __m512 min = V::fmax(axial_min_xy, axial_min_z);
+		const __m512 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+		// a closer hit is a hit, so no need to blend MAXFLOAT in for misses
+		const __mmask16 closer =
+			_mm512_cmp_ps_mask(_mm512_setzero_ps(), min, _CMP_LT_OQ) &
+			_mm512_cmp_ps_mask(min, max, _CMP_LT_OQ) &
+			_mm512_cmp_ps_mask(min, closest, _CMP_LT_OQ);
+
+		closest = _mm512_mask_blend_ps(closer, closest, min);
+		closest_a = _mm512_mask_blend_epi32(closer, closest_a, _mm512_maskz_set1_epi32(a_mask, 1));
+		closest_b = _mm512_mask_blend_epi32(closer, closest_b, _mm512_maskz_set1_epi32(b_mask, 1));
+		closest_index = _mm512_mask_blend_epi32(closer, closest_index, index);
+		index = _mm512_add_epi32(index, _mm512_set1_epi32(16));
+	}
+
+	alignas(64) float dist[16];
+	alignas(64) int32_t a[16];
+	alignas(64) int32_t b[16];
+	alignas(64) int32_t idx[16];
+
+	_mm512_store_ps(dist, closest);
+	_mm512_store_si512(a, closest_a);
+	_mm512_store_si512(b, closest_b);
+	_mm512_store_si512(idx, closest_index);
+
+	return reduceLanes(dist, a, b, idx, 16);
+
+#elif __AVX__
+	struct V {
+		static __m256 fmin(__m256 a, __m256 b)
+		{
+			return _mm256_blendv_ps(_mm256_min_ps(a, b), a, _mm256_cmp_ps(b, b, _CMP_UNORD_Q));
+		}
+
+		static __m256 fmax(__m256 a, __m256 b)
+		{
+			return _mm256_blendv_ps(_mm256_max_ps(a, b), a, _mm256_cmp_ps(b, b, _CMP_UNORD_Q));
+		}
+
+		// voxel planes relative to the ray origin
+		static __m256 plane(const float* a, __m256 origin)
+		{
+			return relative ? _mm256_load_ps(a) : _mm256_sub_ps(_mm256_load_ps(a), origin);
+		}
+	};
+
+	const __m256 origin_x = _mm256_set1_ps(ray.origin.x);
+	const __m256 origin_y = _mm256_set1_ps(ray.origin.y);
+	const __m256 origin_z = _mm256_set1_ps(ray.origin.z);
+	const __m256 rcpdir_x = _mm256_set1_ps(ray.rcpdir.x);
+	const __m256 rcpdir_y = _mm256_set1_ps(ray.rcpdir.y);
+	const __m256 rcpdir_z = _mm256_set1_ps(ray.rcpdir.z);
+	const __m256 one = _mm256_castsi256_ps(_mm256_set1_epi32(1));
+
+	// AVX has no 8-wide integer add -- voxel indices advance as two 4-wide halves
+	__m256 closest = _mm256_set1_ps(MAXFLOAT);
+	__m256 closest_a = _mm256_setzero_ps();
+	__m256 closest_b = _mm256_setzero_ps();
+	__m256 closest_index = _mm256_setzero_ps();
+	__m128i index_lo = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i index_hi = _mm_setr_epi32(4, 5, 6, 7);
+
+	for (size_t i = 0; i < scene.padded_size(); i += 8) {
+		const __m256 t0_x = _mm256_mul_ps(V::plane(scene.min_x + i, origin_x), rcpdir_x);
+		const __m256 t0_y = _mm256_mul_ps(V::plane(scene.min_y + i, origin_y), rcpdir_y);
+		const __m256 t0_z = _mm256_mul_ps(V::plane(scene.min_z + i, origin_z), rcpdir_z);
+		const __m256 t1_x = _mm256_mul_ps(V::plane(scene.max_x + i, origin_x), rcpdir_x);
+		const __m256 t1_y = _mm256_mul_ps(V::plane(scene.max_y + i, origin_y), rcpdir_y);
+		const __m256 t1_z = _mm256_mul_ps(V::plane(scene.max_z + i, origin_z), rcpdir_z);
+
+		const __m256 axial_min_x = V::fmin(t0_x, t1_x);
+		const __m256 axial_min_y = V::fmin(t0_y, t1_y);
+		const __m256 axial_min_z = V::fmin(t0_z, t1_z);
+		const __m256 axial_max_x = V::fmax(t0_x, t1_x);
+		const __m256 axial_max_y = V::fmax(t0_y, t1_y);
+		const __m256 axial_max_z = V::fmax(t0_z, t1_z);
+
+		const __m256 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+		const __m256 a = _mm256_and_ps(_mm256_cmp_ps(axial_min_x, axial_min_y, _CMP_GE_OQ), one);
+		const __m256 b = _mm256_and_ps(_mm256_cmp_ps(axial_min_xy, axial_min_z, _CMP_GE_OQ), one);
+
+		const __m256 min = V::fmax(axial_min_xy, axial_min_z);
+		const __m256 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+		// a closer hit is a hit, so no need to blend MAXFLOAT in for misses
+		const __m256 closer = _mm256_and_ps(
+			_mm256_and_ps(
+				_mm256_cmp_ps(_mm256_setzero_ps(), min, _CMP_LT_OQ),
+				_mm256_cmp_ps(min, max, _CMP_LT_OQ)),
+			_mm256_cmp_ps(min, closest, _CMP_LT_OQ));
+
+		closest = _mm256_blendv_ps(closest, min, closer);
+		closest_a = _mm256_blendv_ps(closest_a, a, closer);
+		closest_b = _mm256_blendv_ps(closest_b, b, closer);
+		closest_index = _mm256_blendv_ps(closest_index, _mm256_castsi256_ps(_mm256_set_m128i(index_hi, index_lo)), closer);
+		index_lo = _mm_add_epi32(index_lo, _mm_set1_epi32(8));
+		index_hi = _mm_add_epi32(index_hi, _mm_set1_epi32(8));
+	}
+
+	alignas(32) float dist[8];
+	alignas(32) int32_t a[8];
+	alignas(32) int32_t b[8];
+	alignas(32) int32_t idx[8];
+
+	_mm256_store_ps(dist, closest);
+	_mm256_store_ps(reinterpret_cast< float* >(a), closest_a);
+	_mm256_store_ps(reinterpret_cast< float* >(b), closest_b);
+	_mm256_store_ps(reinterpret_cast< float* >(idx), closest_index);
+
+	return reduceLanes(dist, a, b, idx, 8);
+
+#elif __SSE2__
+	struct V {
+		static __m128 select(__m128 arg_else, __m128 arg_then, __m128 pred)
+		{
+			return _mm_or_ps(_mm_and_ps(pred, arg_then), _mm_andnot_ps(pred, arg_else));
+		}
+
+		static __m128 fmin(__m128 a, __m128 b)
+		{
+			return select(_mm_min_ps(a, b), a, _mm_cmpunord_ps(b, b));
+		}
+
+		static __m128 fmax(__m128 a, __m128 b)
+		{
+			return select(_mm_max_ps(a, b), a, _mm_cmpunord_ps(b, b));
+		}
+
+		// voxel planes relative to the ray origin
+		static __m128 plane(const float* a, __m128 origin)
+		{
+			return relative ? _mm_load_ps(a) : _mm_sub_ps(_mm_load_ps(a), origin);
+		}
+	};
+
+	const __m128 origin_x = _mm_set1_ps(ray.origin.x);
+	const __m128 origin_y = _mm_set1_ps(ray.origin.y);
+	const __m128 origin_z = _mm_set1_ps(ray.origin.z);
+	const __m128 rcpdir_x = _mm_set1_ps(ray.rcpdir.x);
+	const __m128 rcpdir_y = _mm_set1_ps(ray.rcpdir.y);
+	const __m128 rcpdir_z = _mm_set1_ps(ray.rcpdir.z);
+	const __m128 one = _mm_castsi128_ps(_mm_set1_epi32(1));
+
+	__m128 closest = _mm_set1_ps(MAXFLOAT);
+	__m128 closest_a = _mm_setzero_ps();
+	__m128 closest_b = _mm_setzero_ps();
+	__m128 closest_index = _mm_setzero_ps();
+	__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+	for (size_t i = 0; i < scene.padded_size(); i += 4) {
+		const __m128 t0_x = _mm_mul_ps(V::plane(scene.min_x + i, origin_x), rcpdir_x);
+		const __m128 t0_y = _mm_mul_ps(V::plane(scene.min_y + i, origin_y), rcpdir_y);
+		const __m128 t0_z = _mm_mul_ps(V::plane(scene.min_z + i, origin_z), rcpdir_z);
+		const __m128 t1_x = _mm_mul_ps(V::plane(scene.max_x + i, origin_x), rcpdir_x);
+		const __m128 t1_y = _mm_mul_ps(V::plane(scene.max_y + i, origin_y), rcpdir_y);
+		const __m128 t1_z = _mm_mul_ps(V::plane(scene.max_z + i, origin_z), rcpdir_z);
+
+		const __m128 axial_min_x = V::fmin(t0_x, t1_x);
+		const __m128 axial_min_y = V::fmin(t0_y, t1_y);
+		const __m128 axial_min_z = V::fmin(t0_z, t1_z);
+		const __m128 axial_max_x = V::fmax(t0_x, t1_x);
+		const __m128 axial_max_y = V::fmax(t0_y, t1_y);
+		const __m128 axial_max_z = V::fmax(t0_z, t1_z);
+
+		const __m128 axial_min_xy = V::fmax(axial_min_x, axial_min_y);
+		const __m128 a = _mm_and_ps(_mm_cmpge_ps(axial_min_x, axial_min_y), one);
+		const __m128 b = _mm_and_ps(_mm_cmpge_ps(axial_min_xy, axial_min_z), one);
+
+		const __m128 min = V::fmax(axial_min_xy, axial_min_z);
+		const __m128 max = V::fmin(V::fmin(axial_max_x, axial_max_y), axial_max_z);
+
+		// a closer hit is a hit, so no need to blend MAXFLOAT in for misses
+		const __m128 closer = _mm_and_ps(
+			_mm_and_ps(
+				_mm_cmplt_ps(_mm_setzero_ps(), min),
+				_mm_cmplt_ps(min, max)),
+			_mm_cmplt_ps(min, closest));
+
+		closest = V::select(closest, min, closer);
+		closest_a = V::select(closest_a, a, closer);
+		closest_b = V::select(closest_b, b, closer);
+		closest_index = V::select(closest_index, _mm_castsi128_ps(index), closer);
+		index = _mm_add_epi32(index, _mm_set1_epi32(4));
+	}
+
+	alignas(16) float dist[4];
+	alignas(16) int32_t a[4];
+	alignas(16) int32_t b[4];
+	alignas(16) int32_t idx[4];
+
+	_mm_store_ps(dist, closest);
+	_mm_store_ps(reinterpret_cast< float* >(a), closest_a);
+	_mm_store_ps(reinterpret_cast< float* >(b), closest_b);
+	_mm_store_ps(reinterpret_cast< float* >(idx), closest_index);
+
+	return reduceLanes(dist, a, b, idx, 4);
+
+#else
+	Hit closest;
+
+	for (size_t i = 0; i < scene.size(); ++i) {
+		const Hit hit = relative ? intersectRelative(scene.get(i), ray.rcpdir) : intersect(scene.get(i), ray);
+
+		if (hit.dist < closest.dist)
+			closest = hit;
+	}
+
+	return closest;
+
+#endif
+}
+
+inline Hit intersect(
+	const VoxelSoA& scene,
+	const Ray& ray)
+{
+	return intersectArrays< false >(scene, ray);
+}
+
+// structure-of-arrays scene, translated to be relative to the common origin of all rays shot at it; should the
+// translated copy fail to allocate, rays take the scene as is
+class RelativeVoxelSoA : testbed::non_copyable
+{
+public:
+	const VoxelSoA& scene;
+	const VoxelSoA relative;
+
+	RelativeVoxelSoA(const VoxelSoA& scene, const float3& origin)
+	: scene(scene)
+	, relative(scene, origin)
+	{}
+};
+
+// closest hit of a ray from the common origin
+inline Hit intersect(
+	const RelativeVoxelSoA& scene,
+	const Ray& ray)
+{
+	return scene.relative.is_valid() ? intersectArrays< true >(scene.relative, ray) : intersectArrays< false >(scene.scene, ray);
+}
+
+// scene as traversed by rays all starting at origin, see render.hpp
+inline RelativeVoxelSoA originScene(
+	const VoxelSoA& scene,
+	const float3& origin)
+{
+	return RelativeVoxelSoA(scene, origin);
+}
+
+#endif // soa_H__
@@ -8,19 +8,203 @@
 #include <io.h>
 #else
 #include <unistd.h>
+#include <sys/uio.h>
 #endif
 #include <assert.h>
+#include <algorithm>
+#include <mutex>
 #include <string>
 #include <cstring>
+#include <type_traits>
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
 
 namespace stream {
 
+// byte order of binary data
+enum Endian {
+	little_endian,
+	big_endian,
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	native_endian = big_endian
+#else
+	native_endian = little_endian
+#endif
+};
+
+// a run of bytes of a gathered write
+struct span {
+	const void* data;
+	size_t size;
+};
+
+// reverse the bytes of each of count elements of the given size
+inline void swapBytes(void* const data, const size_t size, const size_t count)
+{
+	uint8_t* it = static_cast< uint8_t* >(data);
+
+	for (size_t i = 0; i < count; ++i, it += size)
+		std::reverse(it, it + size);
+}
+
+// input is read in large blocks into a buffer of its own, and tokenized and parsed off that buffer, rather than one
+// getc or fscanf at a time; numeric extraction skips leading whitespace and consumes as much of the input as fscanf
+// would, and end of file is flagged, as by feof, once a read is attempted past the end; is_good reflects read errors
+// alone, as ferror did; a failed extraction is flagged by is_fail instead, as by failbit with std::istream, until
+// set_good
 class in {
 	FILE* file;
 
+	enum {
+		buffer_size = 1 << 16,
+		max_number = 128 // longest numeric token parsed
+	};
+
+	mutable char* buffer;
+	mutable size_t pos;
+	mutable size_t end;
+	mutable bool eof;
+	mutable bool error;
+	mutable bool fail;
+
+	// have at least count bytes ahead of pos, short of the end of input; false if none are ahead
+	bool fill(const size_t count) const {
+		if (end - pos >= count)
+			return true;
+
+		if (0 == file || eof)
+			return pos != end;
+
+		memmove(buffer, buffer + pos, end - pos);
+		end -= pos;
+		pos = 0;
+
+		// read() rather than fread(), which would wait on a pipe or terminal until the whole block arrives
+		while (end < count) {
+			const long nread = long(::read(fileno(file), buffer + end, unsigned(buffer_size - end)));
+
+			if (nread <= 0) {
+				eof = true;
+				error = 0 > nread;
+				break;
+			}
+
+			end += size_t(nread);
+		}
+
+		return pos != end;
+	}
+
+	static bool is_space(const char c) {
+		return ' ' == c || '\t' == c || '\n' == c || '\r' == c || '\v' == c || '\f' == c;
+	}
+
+	// have the token at pos whole in the buffer, short of max_number bytes or the end of input; reading on only until
+	// a delimiter turns up keeps a terminal from waiting on input past the token
+	void fill_token() const {
+		size_t len = 0;
+
+		while (true) {
+			for (; pos + len < end && len < max_number; ++len)
+				if (is_space(buffer[pos + len]))
+					return;
+
+			if (len >= max_number || !fill(len + 1) || end - pos <= len)
+				return;
+		}
+	}
+
+	bool skip_space() const {
+		while (fill(1)) {
+			if (!is_space(buffer[pos]))
+				return true;
+
+			++pos;
+		}
+
+		return false;
+	}
+
+	// integer in base 10, as by %d and kin: optional sign, then digits; unsigned types take a sign as well, negating
+	// modulo their range
+	template < typename T >
+	bool parse_integer(T& a) const {
+		if (!skip_space())
+			return false;
+
+		fill_token();
+
+		const bool negative = '-' == buffer[pos];
+		size_t i = pos + ('-' == buffer[pos] || '+' == buffer[pos]);
+		const size_t first = i;
+		uint64_t value = 0;
+
+		for (; i < end && '0' <= buffer[i] && buffer[i] <= '9'; ++i)
+			value = value * 10 + uint64_t(buffer[i] - '0');
+
+		if (first == i)
+			return false;
+
+		pos = i;
+		a = T(negative ? 0 - value : value);
+
+		if (end == pos)
+			fill(1);
+
+		return true;
+	}
+
+	// real or pointer through strto*, over a copy of the token, advancing past what that took
+	template < typename T, typename F >
+	bool parse_token(T& a, F convert) const {
+		if (!skip_space())
+			return false;
+
+		fill_token();
+
+		char token[max_number + 1];
+		size_t len = 0;
+
+		for (; len < max_number && pos + len < end && !is_space(buffer[pos + len]); ++len)
+			token[len] = buffer[pos + len];
+
+		token[len] = '\0';
+		char* token_end;
+		a = convert(token, &token_end);
+
+		if (token == token_end)
+			return false;
+
+		pos += token_end - token;
+
+		if (end == pos)
+			fill(1);
+
+		return true;
+	}
+
+	static float to_float(const char* str, char** str_end) {
+		return strtof(str, str_end);
+	}
+
+	static double to_double(const char* str, char** str_end) {
+		return strtod(str, str_end);
+	}
+
+	static void* to_pointer(const char* str, char** str_end) {
+		return reinterpret_cast< void* >(uintptr_t(strtoull(str, str_end, 16)));
+	}
+
 public:
 	in()
-	: file(0) {
+	: file(0)
+	, buffer(0)
+	, pos(0)
+	, end(0)
+	, eof(false)
+	, error(false)
+	, fail(false) {
 	}
 
 	void close() {
@@ -29,12 +213,24 @@ public:
 
 		fclose(file);
 		file = 0;
+		free(buffer);
+		buffer = 0;
+		pos = 0;
+		end = 0;
+		eof = false;
+		error = false;
+		fail = false;
 	}
 
 	bool open(const char* const filename) {
 		close();
 
-		file = fopen(filename, "r");
+		file = fopen(filename, "rb");
+		buffer = 0 != file ? (char*) malloc(buffer_size) : 0;
+
+		if (0 == buffer)
+			close();
+
 		return 0 != file;
 	}
 
@@ -45,6 +241,11 @@ public:
 		if (-1 != fd)
 			file = fdopen(dup(fd), "r");
 
+		buffer = 0 != file ? (char*) malloc(buffer_size) : 0;
+
+		if (0 == buffer)
+			close();
+
 		return 0 != file;
 	}
 
@@ -54,31 +255,40 @@ public:
 
 	bool is_eof() const {
 		if (0 != file)
-			return static_cast< bool >(feof(file));
+			return eof && pos == end;
 
 		return false;
 	}
 
 	bool is_good() const {
-		return (0 != file) && (0 == ferror(file));
+		return (0 != file) && (0 == ferror(file)) && !error;
+	}
+
+	// an extraction found no number where one was due
+	bool is_fail() const {
+		return fail;
 	}
 
 	void set_good() const {
 		if (0 != file)
 			clearerr(file);
+
+		eof = false;
+		error = false;
+		fail = false;
 	}
 
 	const in& operator >>(char& a) const {
 		if (0 != file)
-			a = getc(file);
+			a = fill(1) ? buffer[pos++] : char(EOF);
 
 		return *this;
 	}
 
 	const in& operator >>(int16_t& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%hd", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
 
 		return *this;
@@ -86,8 +296,8 @@ public:
 
 	const in& operator >>(uint16_t& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%hu", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
 
 		return *this;
@@ -95,8 +305,8 @@ public:
 
 	const in& operator >>(int32_t& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%d", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
 
 		return *this;
@@ -104,8 +314,8 @@ public:
 
 	const in& operator >>(uint32_t& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%u", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
 
 		return *this;
@@ -113,29 +323,19 @@ public:
 
 	const in& operator >>(int64_t& a) const {
 		if (0 != file) {
-#if _MSC_VER || __APPLE__ || __SIZEOF_LONG__ == 4
-			const int nread = fscanf(file, "%lld", &a);
-
-#else
-			const int nread = fscanf(file, "%ld", &a);
-
-#endif
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
+
 		return *this;
 	}
 
 	const in& operator >>(uint64_t& a) const {
 		if (0 != file) {
-#if _MSC_VER || __APPLE__ || __SIZEOF_LONG__ == 4
-			const int nread = fscanf(file, "%llu", &a);
-
-#else
-			const int nread = fscanf(file, "%lu", &a);
-
-#endif
-			assert(1 == nread); (void) nread;
+			if (!parse_integer(a))
+				fail = true;
 		}
+
 		return *this;
 	}
 
@@ -154,8 +354,8 @@ public:
 #endif
 	const in& operator >>(float& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%f", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_token(a, to_float))
+				fail = true;
 		}
 
 		return *this;
@@ -163,8 +363,8 @@ public:
 
 	const in& operator >>(double& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%lf", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_token(a, to_double))
+				fail = true;
 		}
 
 		return *this;
@@ -172,38 +372,79 @@ public:
 
 	const in& operator >>(void*& a) const {
 		if (0 != file) {
-			const int nread = fscanf(file, "%p", &a);
-			assert(1 == nread); (void) nread;
+			if (!parse_token(a, to_pointer))
+				fail = true;
 		}
 
 		return *this;
 	}
 
-	const in& operator >>(std::string& a) const {
-		if (0 != file) {
-			const size_t buffer_inc = 1024;
-			size_t buffer_size = 0;
-			size_t len = 0;
-			char* buffer = 0;
+	// count elements of a trivially-copyable type, stored in the given byte order; returns the number of elements read
+	// whole, short of count at the end of input; the bulk of a large read goes straight to the destination
+	template < typename T >
+	size_t read(T* const dst, const size_t count, const Endian order = native_endian) const {
+		static_assert(std::is_trivially_copyable< T >::value, "binary read of a non-trivially-copyable type");
 
-			while (true) {
-				if (feof(file) || ferror(file))
+		if (0 == file)
+			return 0;
+
+		uint8_t* const bytes = reinterpret_cast< uint8_t* >(dst);
+		const size_t len = count * sizeof(T);
+		size_t done = 0;
+
+		while (done < len) {
+			if (len - done >= buffer_size && pos == end) {
+				if (eof)
 					break;
 
-				if (len == buffer_size) {
-					buffer_size += buffer_inc;
-					buffer = (char*) realloc(buffer, buffer_size);
-				}
+				const long nread = long(::read(fileno(file), bytes + done, unsigned(std::min(len - done, size_t(1) << 30))));
 
-				const char read = getc(file);
-				if (' ' == read || '\t' == read || '\n' == read)
+				if (nread <= 0) {
+					eof = true;
+					error = 0 > nread;
 					break;
+				}
 
-				buffer[len++] = read;
+				done += size_t(nread);
+				continue;
 			}
 
-			a.assign(buffer, len);
-			free(buffer);
+			if (!fill(std::min(len - done, size_t(buffer_size))))
+				break;
+
+			const size_t n = std::min(len - done, end - pos);
+			memcpy(bytes + done, buffer + pos, n);
+			pos += n;
+			done += n;
+		}
+
+		if (native_endian != order && 1 < sizeof(T))
+			swapBytes(dst, sizeof(T), done / sizeof(T));
+
+		return done / sizeof(T);
+	}
+
+	// characters up to, and excluding, the next space, tab or newline, which is consumed
+	const in& operator >>(std::string& a) const {
+		if (0 != file) {
+			a.clear();
+
+			while (fill(1)) {
+				const char* const first = buffer + pos;
+				const char* const last = buffer + end;
+				const char* delim = first;
+
+				while (delim != last && ' ' != *delim && '\t' != *delim && '\n' != *delim)
+					++delim;
+
+				a.append(first, delim);
+				pos += delim - first;
+
+				if (delim != last) {
+					++pos;
+					break;
+				}
+			}
 		}
 
 		return *this;
@@ -240,6 +481,11 @@ enum TerminatorFuncId {
 	flush // std::basic_ostream< char, std::char_traits< char > >& flush(std::basic_ostream< char, std::char_traits< char > >&)
 };
 
+// output is formatted straight into a buffer of its own, and handed to the file, unbuffered, in large writes -- when
+// the buffer fills, on flush and on close, or, for a terminal, at the end of each line; stderr, as with stdio, is
+// unbuffered: each insertion goes out as it completes, wherever stderr is redirected; numbers come out as by the
+// printf conversions of old: %d/%u/%x/%o of the argument type and %f, padded to the width by the fill char, which
+// goes after the sign in the case of '0'; one stream can be written from several threads
 class out {
 	FILE* file;
 	int width;
@@ -251,84 +497,235 @@ class out {
 		BASE_OCT
 	} base;
 
-	static size_t setFillInFormatStr(
-		char (& format)[64],
-		size_t fmtlen,
-		const char fillchar) {
+	enum {
+		buffer_size = 1 << 16,
+		max_number = 512 // longest number formatted: %f of DBL_MAX is 316 chars
+	};
+
+	char* buffer;
+	size_t pos;
+	bool line_buffered;
+	bool unbuffered;
+	bool error;
+	mutable std::mutex mutex;
+
+	// one insertion, under the lock; of an unbuffered stream, drained on completion
+	class insertion {
+		out& stream;
+
+	public:
+		insertion(out& stream)
+		: stream(stream) {
+			stream.mutex.lock();
+		}
+
+		~insertion() {
+			if (stream.unbuffered)
+				stream.drain();
+
+			stream.mutex.unlock();
+		}
+	};
+
+	void drain() {
+		if (0 != pos && pos != fwrite(buffer, sizeof(*buffer), pos, file))
+			error = true;
+
+		pos = 0;
+	}
+
+	void put(const char* const src, const size_t len) {
+		if (len > buffer_size - pos) {
+			drain();
+
+			if (len >= buffer_size) {
+				if (len != fwrite(src, sizeof(*src), len, file))
+					error = true;
+
+				return;
+			}
+		}
+
+		memcpy(buffer + pos, src, len);
+		pos += len;
+
+		if (line_buffered && 0 != memchr(src, '\n', len))
+			drain();
+	}
+
+	void put(const char a) {
+		if (buffer_size == pos)
+			drain();
+
+		buffer[pos++] = a;
+
+		if (line_buffered && '\n' == a)
+			drain();
+	}
+
+	// digits of the magnitude in the current base, preceded by a minus if negative, padded to the width
+	void put_integer(const uint64_t magnitude, const bool negative) {
+		const unsigned shift = BASE_HEX == base ? 4 : 3;
+		char digits[24];
+		char* const last = digits + sizeof(digits);
+		char* first = last;
+		uint64_t a = magnitude;
+
+		if (BASE_DEC == base)
+			do {
+				*--first = char('0' + a % 10);
+				a /= 10;
+			} while (a);
+		else
+			do {
+				*--first = "0123456789abcdef"[a & ((1u << shift) - 1)];
+				a >>= shift;
+			} while (a);
+
+		if (negative)
+			*--first = '-';
+
+		put_padded(first, size_t(last - first));
+	}
+
+	void put_padded(const char* first, size_t len) {
+		size_t pad = width > 0 && size_t(width) > len ? size_t(width) - len : 0;
+
+		// reset width as per std::ostream specs
+		width = 0;
+
+		if ('0' == fillchar && 0 != pad && ('-' == *first || '+' == *first)) {
+			put(*first++);
+			--len;
+		}
+
+		for (; pad; --pad)
+			put(fillchar);
+
+		put(first, len);
+	}
+
+	template < typename S >
+	out& put_signed(const S a) {
+		typedef typename std::make_unsigned< S >::type U;
+
+		if (0 == file)
+			return *this;
+
+		const insertion lock(*this);
+
+		// hex and oct show the two's complement, as by %x/%o
+		if (BASE_DEC != base || 0 <= a)
+			put_integer(U(a), false);
+		else
+			put_integer(0 - uint64_t(int64_t(a)), true);
+
+		return *this;
+	}
+
+	template < typename U >
+	out& put_unsigned(const U a) {
+		if (0 == file)
+			return *this;
+
+		const insertion lock(*this);
+		put_integer(a, false);
+		return *this;
+	}
+
+	// fixed notation of 6 decimals, as by %f; base does not apply
+	out& put_real(const double a) {
+		if (0 == file)
+			return *this;
+
+		const insertion lock(*this);
+		char digits[max_number];
+
+#if __cpp_lib_to_chars >= 201611L
+		const std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), a, std::chars_format::fixed, 6);
+		const size_t len = size_t(res.ptr - digits);
 
-		const char fill_space[] = "%*";
-		const char fill_zero[] = "%0*";
-		const char fill_other[] = "<bad_fill> %*";
+#else
+		const int n = snprintf(digits, sizeof(digits), "%f", a);
+		const size_t len = 0 < n ? std::min(size_t(n), sizeof(digits) - 1) : 0;
 
-		switch (fillchar) {
-		case ' ':
-			memcpy(format + fmtlen, fill_space, strlen(fill_space));
-			fmtlen += strlen(fill_space);
-			break;
+#endif
+		put_padded(digits, len);
+		return *this;
+	}
 
-		case '0':
-			memcpy(format + fmtlen, fill_zero, strlen(fill_zero));
-			fmtlen += strlen(fill_zero);
-			break;
+	void set_buffering() {
+		buffer = 0 != file ? (char*) malloc(buffer_size) : 0;
 
-		default:
-			memcpy(format + fmtlen, fill_other, strlen(fill_other));
-			fmtlen += strlen(fill_other);
-			break;
+		if (0 == buffer) {
+			close();
+			return;
 		}
 
-		return fmtlen;
+		// ours is the only buffer; drained in large writes
+		setvbuf(file, 0, _IONBF, 0);
+		line_buffered = isatty(fileno(file));
 	}
 
-	static size_t setBaseInFormatStr(
-		char (& format)[64],
-		size_t fmtlen,
-		const Base base,
-		const char* base_dec,
-		const char* base_hex,
-		const char* base_oct) {
+#ifndef _MSC_VER
+	// gathered write, carrying on past partial writes; modifies the iovecs
+	bool write_all(iovec* iov, int niov) {
+		while (niov) {
+			const ssize_t nwritten = ::writev(fileno(file), iov, niov);
+
+			if (0 > nwritten)
+				return false;
 
-		switch (base) {
-		case BASE_DEC:
-			memcpy(format + fmtlen, base_dec, strlen(base_dec));
-			fmtlen += strlen(base_dec);
-			break;
+			size_t left = size_t(nwritten);
 
-		case BASE_HEX:
-			memcpy(format + fmtlen, base_hex, strlen(base_hex));
-			fmtlen += strlen(base_hex);
-			break;
+			for (; niov && left >= iov->iov_len; ++iov, --niov)
+				left -= iov->iov_len;
 
-		case BASE_OCT:
-			memcpy(format + fmtlen, base_oct, strlen(base_oct));
-			fmtlen += strlen(base_oct);
-			break;
+			if (niov) {
+				iov->iov_base = static_cast< char* >(iov->iov_base) + left;
+				iov->iov_len -= left;
+			}
 		}
 
-		return fmtlen;
+		return true;
 	}
 
+#endif
+
 public:
 	out()
 	: file(0)
 	, width(0)
 	, fillchar(' ')
-	, base(BASE_DEC) {
+	, base(BASE_DEC)
+	, buffer(0)
+	, pos(0)
+	, line_buffered(false)
+	, unbuffered(false)
+	, error(false) {
 	}
 
 	void close() {
 		if (0 == file)
 			return;
 
+		if (0 != buffer)
+			drain();
+
 		fclose(file);
 		file = 0;
+		free(buffer);
+		buffer = 0;
+		unbuffered = false;
+		error = false;
 	}
 
 	bool open(const char* const filename, const bool append = true) {
 		close();
 
-		const char* const mode = append ? "a" : "w";
+		const char* const mode = append ? "ab" : "wb";
 		file = fopen(filename, mode);
+		set_buffering();
 		return 0 != file;
 	}
 
@@ -339,6 +736,8 @@ public:
 		if (-1 != fd)
 			file = fdopen(dup(fd), "a");
 
+		set_buffering();
+		unbuffered = 0 != file && fileno(stderr) == fd;
 		return 0 != file;
 	}
 
@@ -347,183 +746,152 @@ public:
 	}
 
 	out& write(const char* const src, const size_t len) {
-		if (0 != file && 0 != src && 0 != len)
-			fwrite(src, sizeof(*src), len, file);
+		if (0 != file && 0 != src && 0 != len) {
+			const insertion lock(*this);
+			put(src, len);
+		}
 
 		return *this;
 	}
 
-	void flush() const {
-		if (0 != file)
-			fflush(file);
-	}
-
-	bool is_good() const {
-		return (0 != file) && (0 == ferror(file));
-	}
+	// count elements of a trivially-copyable type, stored in the given byte order
+	template < typename T >
+	out& write(const T* const src, const size_t count, const Endian order = native_endian) {
+		static_assert(std::is_trivially_copyable< T >::value, "binary write of a non-trivially-copyable type");
 
-	void set_good() const {
-		if (0 != file)
-			clearerr(file);
-	}
-
-	out& operator <<(const char a) {
-		if (0 != file)
-			putc(a, file);
-
-		return *this;
-	}
-
-	out& operator <<(const int16_t a) {
-		if (0 == file)
+		if (0 == file || 0 == src || 0 == count)
 			return *this;
 
-		char format[64];
-		size_t fmtlen = 0;
-
-		const char base_dec[] = "hd";
-		const char base_hex[] = "hx";
-		const char base_oct[] = "ho";
+		const insertion lock(*this);
 
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
+		if (native_endian == order || 1 == sizeof(T)) {
+			put(reinterpret_cast< const char* >(src), count * sizeof(T));
+			return *this;
+		}
 
-		format[fmtlen++] = '\0';
+		// swapped in the buffer, a buffer-full at a time
+		for (size_t i = 0; i < count; ) {
+			if (buffer_size - pos < sizeof(T))
+				drain();
 
-		fprintf(file, format, width, a);
+			const size_t n = std::min(count - i, (buffer_size - pos) / sizeof(T));
+			memcpy(buffer + pos, src + i, n * sizeof(T));
+			swapBytes(buffer + pos, sizeof(T), n);
+			pos += n * sizeof(T);
+			i += n;
+		}
 
-		// reset width as per std::ostream specs
-		width = 0;
 		return *this;
 	}
 
-	out& operator <<(const uint16_t a) {
+	// count runs of bytes, in order; runs that do not fit the buffer go out, along with what is buffered, in gathered
+	// writes straight from their sources
+	out& writev(const span* const spans, const size_t count) {
 		if (0 == file)
 			return *this;
 
-		char format[64];
-		size_t fmtlen = 0;
-
-		const char base_dec[] = "hu";
-		const char base_hex[] = "hx";
-		const char base_oct[] = "ho";
-
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
-
-		format[fmtlen++] = '\0';
+		const insertion lock(*this);
+		size_t total = 0;
 
-		fprintf(file, format, width, a);
+		for (size_t i = 0; i < count; ++i)
+			total += spans[i].size;
 
-		// reset width as per std::ostream specs
-		width = 0;
-		return *this;
-	}
+		if (total <= buffer_size - pos) {
+			for (size_t i = 0; i < count; ++i)
+				if (spans[i].size) {
+					memcpy(buffer + pos, spans[i].data, spans[i].size);
+					pos += spans[i].size;
+				}
 
-	out& operator <<(const int32_t a) {
-		if (0 == file)
 			return *this;
+		}
 
-		char format[64];
-		size_t fmtlen = 0;
+#ifdef _MSC_VER
+		for (size_t i = 0; i < count; ++i)
+			put(static_cast< const char* >(spans[i].data), spans[i].size);
 
-		const char base_dec[] = "d";
-		const char base_hex[] = "x";
-		const char base_oct[] = "o";
+#else
+		const size_t max_iov = 64;
+		iovec iov[max_iov];
+		size_t niov = 0;
+
+		if (pos) {
+			iov[niov].iov_base = buffer;
+			iov[niov++].iov_len = pos;
+			pos = 0;
+		}
 
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
+		for (size_t i = 0; i <= count; ++i) {
+			if (i < count && 0 == spans[i].size)
+				continue;
 
-		format[fmtlen++] = '\0';
+			if (max_iov == niov || (i == count && niov)) {
+				if (!write_all(iov, int(niov)))
+					error = true;
 
-		fprintf(file, format, width, a);
+				niov = 0;
+			}
 
-		// reset width as per std::ostream specs
-		width = 0;
+			if (i < count) {
+				iov[niov].iov_base = const_cast< void* >(spans[i].data);
+				iov[niov++].iov_len = spans[i].size;
+			}
+		}
+
+#endif
 		return *this;
 	}
 
-	out& operator <<(const uint32_t a) {
-		if (0 == file)
-			return *this;
-
-		char format[64];
-		size_t fmtlen = 0;
+	void flush() {
+		if (0 != file) {
+			const insertion lock(*this);
+			drain();
+			fflush(file);
+		}
+	}
 
-		const char base_dec[] = "u";
-		const char base_hex[] = "x";
-		const char base_oct[] = "o";
+	bool is_good() const {
+		return (0 != file) && (0 == ferror(file)) && !error;
+	}
 
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
+	void set_good() {
+		if (0 != file)
+			clearerr(file);
 
-		format[fmtlen++] = '\0';
+		error = false;
+	}
 
-		fprintf(file, format, width, a);
+	out& operator <<(const char a) {
+		if (0 != file) {
+			const insertion lock(*this);
+			put(a);
+		}
 
-		// reset width as per std::ostream specs
-		width = 0;
 		return *this;
 	}
 
-	out& operator <<(const int64_t a) {
-		if (0 == file)
-			return *this;
-
-		char format[64];
-		size_t fmtlen = 0;
-
-#if _MSC_VER || __APPLE__ || __SIZEOF_LONG__ == 4
-		const char base_dec[] = "lld";
-		const char base_hex[] = "llx";
-		const char base_oct[] = "llo";
-
-#else
-		const char base_dec[] = "ld";
-		const char base_hex[] = "lx";
-		const char base_oct[] = "lo";
+	out& operator <<(const int16_t a) {
+		return put_signed(a);
+	}
 
-#endif
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
+	out& operator <<(const uint16_t a) {
+		return put_unsigned(a);
+	}
 
-		format[fmtlen++] = '\0';
+	out& operator <<(const int32_t a) {
+		return put_signed(a);
+	}
 
-		fprintf(file, format, width, a);
+	out& operator <<(const uint32_t a) {
+		return put_unsigned(a);
+	}
 
-		// reset width as per std::ostream specs
-		width = 0;
-		return *this;
+	out& operator <<(const int64_t a) {
+		return put_signed(a);
 	}
 
 	out& operator <<(const uint64_t a) {
-		if (0 == file)
-			return *this;
-
-		char format[64];
-		size_t fmtlen = 0;
-
-#if _MSC_VER || __APPLE__ || __SIZEOF_LONG__ == 4
-		const char base_dec[] = "llu";
-		const char base_hex[] = "llx";
-		const char base_oct[] = "llo";
-
-#else
-		const char base_dec[] = "lu";
-		const char base_hex[] = "lx";
-		const char base_oct[] = "lo";
-
-#endif
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-		fmtlen = setBaseInFormatStr(format, fmtlen, base, base_dec, base_hex, base_oct);
-
-		format[fmtlen++] = '\0';
-
-		fprintf(file, format, width, a);
-
-		// reset width as per std::ostream specs
-		width = 0;
-		return *this;
+		return put_unsigned(a);
 	}
 
 #if __APPLE__ // type size_t is unrelated to same-size type uint*_t
@@ -540,60 +908,50 @@ public:
 #endif
 #endif
 	out& operator <<(const float a) {
-		if (0 == file)
-			return *this;
-
-		char format[64];
-		size_t fmtlen = 0;
-
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-
-		format[fmtlen++] = 'f';
-		format[fmtlen++] = '\0';
-
-		fprintf(file, format, width, a);
-
-		// reset width as per std::ostream specs
-		width = 0;
-		return *this;
+		return put_real(a);
 	}
 
 	out& operator <<(const double a) {
-		if (0 == file)
-			return *this;
-
-		char format[64];
-		size_t fmtlen = 0;
-
-		fmtlen = setFillInFormatStr(format, fmtlen, fillchar);
-
-		format[fmtlen++] = 'f';
-		format[fmtlen++] = '\0';
-
-		fprintf(file, format, width, a);
-
-		// reset width as per std::ostream specs
-		width = 0;
-		return *this;
+		return put_real(a);
 	}
 
+	// as by glibc's %p: 0x and hex digits, or (nil)
 	out& operator <<(const void* const a) {
-		if (0 != file)
-			fprintf(file, "%p", a);
+		if (0 != file && 0 == a) {
+			const insertion lock(*this);
+			put("(nil)", 5);
+		}
+		else
+		if (0 != file) {
+			const insertion lock(*this);
+			const Base prior = base;
+			const int prior_width = width;
+
+			put("0x", 2);
+			base = BASE_HEX;
+			width = 0;
+			put_integer(uintptr_t(a), false);
+			base = prior;
+			width = prior_width;
+		}
 
 		return *this;
 	}
 
 	out& operator <<(const char* const a) {
-		if (0 != file)
-			fputs(a, file);
+		if (0 != file) {
+			const insertion lock(*this);
+			put(a, strlen(a));
+		}
 
 		return *this;
 	}
 
 	out& operator <<(const std::string& a) {
-		if (0 != file)
-			fputs(a.c_str(), file);
+		if (0 != file) {
+			const insertion lock(*this);
+			put(a.data(), a.size());
+		}
 
 		return *this;
 	}
@@ -634,15 +992,15 @@ public:
 			return *this;
 
 		if (stream::endl == id) {
-			putc('\n', file);
+			*this << '\n';
 		}
 		else
 		if (stream::ends == id) {
-			putc('\0', file);
+			*this << '\0';
 		}
 		else
 		if (stream::flush == id) {
-			fflush(file);
+			flush();
 		}
 		else {
 			assert(0);
@@ -0,0 +1,370 @@
+#ifndef svo_H__
+#define svo_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "raycast.hpp"
+#include "bvh.hpp"
+
+// sparse voxel octree scene -- a cube over the scene bbox, subdivided only where there are voxels; nodes take 8 bytes:
+// inner nodes hold a child mask and the index of their first child, present children being stored consecutively in
+// octant order; leaves either refer to a run of voxel references, or are solid -- the leaf cell is itself a voxel,
+// recorded by its source index alone, so grid-aligned voxel data costs a node per voxel and empty space costs nothing;
+// the root cube is sized a power-of-two multiple of the smallest voxel, so that cells line up with grid-aligned voxels
+//
+// rays traverse the octree front to back over a short stack, children visited nearest-first and culled once entered
+// beyond the closest hit; voxels are tested with intersect(BBox, Ray), solid cells through their cell box, which is
+// bit-identical to the voxel it stands for, so hits and face masks are those of the voxel list; of equidistant hits
+// the voxel first in the source list prevails
+
+constexpr int svo_max_level = 20;
+constexpr size_t svo_leaf_size = 4;
+
+// cells are entered as if this much larger, relative to their side, and culled once entered this much, relatively,
+// beyond the closest hit, lest rounding loses hits on cell boundaries; voxels are referred to only from cells they
+// reach inside of, so that neighbouring voxels do not spoil solid cells
+constexpr float svo_slack = 1.f / 256;
+
+struct SVONode
+{
+	uint32_t first; // inner: first child node; leaf: first voxel reference; solid leaf: source voxel index
+	uint32_t child_mask : 8; // inner: octants present; leaf: zero
+	uint32_t solid : 1;
+	uint32_t count : 23; // leaf: voxel references
+};
+
+class VoxelOctree
+{
+	std::vector< SVONode > node;
+	std::vector< uint32_t > ref; // voxel references of leaves, indices into box
+	std::vector< Voxel > box; // voxels referred to by leaves
+	std::vector< uint32_t > box_index; // source index of each box
+	float3 root_min;
+	float root_side;
+
+	struct Cell
+	{
+		int level;
+		int x;
+		int y;
+		int z;
+
+		Cell child(int octant) const
+		{
+			const Cell c = { level + 1, x * 2 + (octant & 1), y * 2 + (octant >> 1 & 1), z * 2 + (octant >> 2) };
+			return c;
+		}
+	};
+
+	BBox cellBox(const Cell& cell) const
+	{
+		const float side = ldexpf(root_side, -cell.level);
+		return BBox(
+			root_min + float3(side) * float3(float(cell.x), float(cell.y), float(cell.z)),
+			root_min + float3(side) * float3(float(cell.x + 1), float(cell.y + 1), float(cell.z + 1)));
+	}
+
+	static bool equal(const BBox& a, const BBox& b)
+	{
+		return
+			a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+			a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+	}
+
+	// a voxel reaches inside a box, or lies flat within it
+	static bool inside(const BBox& a, const BBox& b)
+	{
+		return
+			((a.min.x < b.max.x && b.min.x < a.max.x) || (a.min.x == a.max.x && b.min.x <= a.min.x && a.min.x <= b.max.x)) &&
+			((a.min.y < b.max.y && b.min.y < a.max.y) || (a.min.y == a.max.y && b.min.y <= a.min.y && a.min.y <= b.max.y)) &&
+			((a.min.z < b.max.z && b.min.z < a.max.z) || (a.min.z == a.max.z && b.min.z <= a.min.z && a.min.z <= b.max.z));
+	}
+
+	// a voxel is the cell box of some cell below the given one
+	bool alignedBelow(const Voxel& voxel, const Cell& cell) const
+	{
+		for (int level = cell.level + 1; level <= svo_max_level; ++level) {
+			const float side = ldexpf(root_side, -level);
+
+			if (voxel.max.x - voxel.min.x > side)
+				return false;
+
+			const Cell c = {
+				level,
+				int((voxel.min.x - root_min.x) / side),
+				int((voxel.min.y - root_min.y) / side),
+				int((voxel.min.z - root_min.z) / side)
+			};
+
+			if (equal(voxel, cellBox(c)))
+				return true;
+		}
+
+		return false;
+	}
+
+	void makeLeaf(uint32_t n, const Voxel* scene, const std::vector< uint32_t >& refs, std::vector< uint32_t >& slot)
+	{
+		node[n].first = uint32_t(ref.size());
+		node[n].count = uint32_t(refs.size());
+
+		for (std::vector< uint32_t >::const_iterator it = refs.begin(); it != refs.end(); ++it) {
+			if (UINT32_MAX == slot[*it]) {
+				slot[*it] = uint32_t(box.size());
+				box.push_back(scene[*it]);
+				box_index.push_back(*it);
+			}
+
+			ref.push_back(slot[*it]);
+		}
+	}
+
+	// refs are source indices, ascending
+	void build(uint32_t n, const Cell& cell, const Voxel* scene, const std::vector< uint32_t >& refs, std::vector< uint32_t >& slot)
+	{
+		const BBox cell_box = cellBox(cell);
+		bool solid = true;
+
+		for (std::vector< uint32_t >::const_iterator it = refs.begin(); it != refs.end() && solid; ++it)
+			solid = equal(scene[*it], cell_box);
+
+		if (solid) {
+			node[n].first = refs.front();
+			node[n].solid = 1;
+			return;
+		}
+
+		// descend while voxels outnumber a leaf, short of cells finer than half the finest voxel here, or while some
+		// voxel may end up a solid cell further down
+		const float child_side = ldexpf(root_side, -cell.level - 1);
+		float min_side = MAXFLOAT;
+
+		for (std::vector< uint32_t >::const_iterator it = refs.begin(); it != refs.end(); ++it) {
+			const float3 size = scene[*it].max - scene[*it].min;
+			min_side = fminf(min_side, fminf(size.x, fminf(size.y, size.z)));
+		}
+
+		bool descend = refs.size() > svo_leaf_size && child_side * 2 >= min_side;
+
+		for (std::vector< uint32_t >::const_iterator it = refs.begin(); it != refs.end() && !descend; ++it)
+			descend = alignedBelow(scene[*it], cell);
+
+		if (!descend || svo_max_level == cell.level) {
+			makeLeaf(n, scene, refs, slot);
+			return;
+		}
+
+		// voxels equal to a child cell go to that child alone, the rest to every child they reach inside of
+		std::vector< uint32_t > child_refs[8];
+		size_t most_refs = 0;
+
+		for (std::vector< uint32_t >::const_iterator it = refs.begin(); it != refs.end(); ++it) {
+			int exact = -1;
+
+			for (int octant = 0; octant < 8 && -1 == exact; ++octant)
+				if (equal(scene[*it], cellBox(cell.child(octant))))
+					exact = octant;
+
+			for (int octant = 0; octant < 8; ++octant)
+				if (exact == octant || (-1 == exact && inside(scene[*it], cellBox(cell.child(octant)))))
+					child_refs[octant].push_back(*it);
+		}
+
+		for (int octant = 0; octant < 8; ++octant)
+			if (child_refs[octant].size() > most_refs)
+				most_refs = child_refs[octant].size();
+
+		// no progress -- all voxels span every child they are in
+		if (most_refs == refs.size() && refs.size() > 1) {
+			bool progress = false;
+
+			for (int octant = 0; octant < 8 && !progress; ++octant)
+				progress = !child_refs[octant].empty() && child_refs[octant].size() < refs.size();
+
+			if (!progress) {
+				makeLeaf(n, scene, refs, slot);
+				return;
+			}
+		}
+
+		const uint32_t first = uint32_t(node.size());
+		uint8_t mask = 0;
+
+		for (int octant = 0; octant < 8; ++octant)
+			if (!child_refs[octant].empty())
+				mask |= 1 << octant;
+
+		node[n].first = first;
+		node[n].child_mask = mask;
+		node.resize(node.size() + __builtin_popcount(mask), SVONode());
+
+		for (int octant = 0, child = 0; octant < 8; ++octant)
+			if (!child_refs[octant].empty())
+				build(first + child++, cell.child(octant), scene, child_refs[octant], slot);
+	}
+
+public:
+	VoxelOctree(const Voxel* scene, size_t count)
+	: node(1, SVONode())
+	, root_min(0.f)
+	, root_side(1.f)
+	{
+		if (0 == count)
+			return;
+
+		const BBox bbox = computeSceneBBox(scene, count);
+		const float3 extent = bbox.max - bbox.min;
+		const float max_extent = fmaxf(extent.x, fmaxf(extent.y, extent.z));
+		float min_side = MAXFLOAT;
+
+		for (size_t i = 0; i < count; ++i) {
+			const float3 size = scene[i].max - scene[i].min;
+			min_side = fminf(min_side, fminf(size.x, fminf(size.y, size.z)));
+		}
+
+		// smallest power-of-two multiple of the smallest voxel that covers the scene, if within reach of the levels
+		root_min = bbox.min;
+		root_side = max_extent > 0.f ? max_extent : 1.f;
+
+		if (min_side > 0.f) {
+			int level = 0;
+			float side = min_side;
+
+			while (side < max_extent && level < svo_max_level) {
+				side *= 2;
+				++level;
+			}
+
+			if (side >= max_extent)
+				root_side = side;
+		}
+
+		std::vector< uint32_t > refs(count);
+		std::vector< uint32_t > slot(count, UINT32_MAX);
+
+		for (size_t i = 0; i < count; ++i)
+			refs[i] = uint32_t(i);
+
+		const Cell root = { 0, 0, 0, 0 };
+		build(0, root, scene, refs, slot);
+	}
+
+	size_t num_nodes() const
+	{
+		return node.empty() || (0 == node[0].child_mask && 0 == node[0].count && 0 == node[0].solid) ? 0 : node.size();
+	}
+
+	// bytes taken by the octree
+	size_t memory() const
+	{
+		return
+			node.size() * sizeof(node[0]) +
+			ref.size() * sizeof(ref[0]) +
+			box.size() * (sizeof(box[0]) + sizeof(box_index[0]));
+	}
+
+	friend Hit intersect(const VoxelOctree& svo, const Ray& ray);
+};
+
+// closest hit over the voxels of an octree
+inline Hit intersect(
+	const VoxelOctree& svo,
+	const Ray& ray)
+{
+	struct Entry
+	{
+		uint32_t node;
+		VoxelOctree::Cell cell;
+		float enter;
+	};
+
+	Hit closest;
+	uint32_t closest_index = UINT32_MAX;
+
+	if (0 == svo.num_nodes())
+		return closest;
+
+	// at most seven siblings wait per level
+	Entry stack[7 * svo_max_level + 1];
+	size_t depth = 0;
+
+	const VoxelOctree::Cell root = { 0, 0, 0, 0 };
+	const BBox root_box = svo.cellBox(root);
+	const float slack = svo.root_side * svo_slack;
+	const Entry first = { 0, root, enter(BBox(root_box.min - float3(slack), root_box.max + float3(slack)), ray) };
+
+	if (MAXFLOAT == first.enter)
+		return closest;
+
+	stack[depth++] = first;
+
+	while (depth) {
+		const Entry e = stack[--depth];
+
+		if (e.enter > closest.dist * (1.f + svo_slack))
+			continue;
+
+		const SVONode& node = svo.node[e.node];
+
+		if (node.solid) {
+			const Hit hit = intersect(svo.cellBox(e.cell), ray);
+
+			if (hit.dist < closest.dist || (MAXFLOAT != hit.dist && hit.dist == closest.dist && node.first < closest_index)) {
+				closest = hit;
+				closest_index = node.first;
+			}
+
+			continue;
+		}
+
+		if (0 == node.child_mask) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const uint32_t b = svo.ref[i];
+				const Hit hit = intersect(svo.box[b], ray);
+
+				if (hit.dist < closest.dist || (MAXFLOAT != hit.dist && hit.dist == closest.dist && svo.box_index[b] < closest_index)) {
+					closest = hit;
+					closest_index = svo.box_index[b];
+				}
+			}
+
+			continue;
+		}
+
+		// children entered, nearest last on the stack
+		const float child_slack = ldexpf(svo.root_side, -e.cell.level - 1) * svo_slack;
+		Entry child[8];
+		size_t num_children = 0;
+
+		for (int octant = 0, index = 0; octant < 8; ++octant) {
+			if (0 == (node.child_mask & 1 << octant))
+				continue;
+
+			const VoxelOctree::Cell cell = e.cell.child(octant);
+			const BBox cell_box = svo.cellBox(cell);
+			const Entry c = {
+				node.first + index++,
+				cell,
+				enter(BBox(cell_box.min - float3(child_slack), cell_box.max + float3(child_slack)), ray)
+			};
+
+			if (MAXFLOAT == c.enter || c.enter > closest.dist * (1.f + svo_slack))
+				continue;
+
+			size_t i = num_children++;
+
+			for (; i > 0 && child[i - 1].enter < c.enter; --i)
+				child[i] = child[i - 1];
+
+			child[i] = c;
+		}
+
+		for (size_t i = 0; i < num_children; ++i)
+			stack[depth++] = child[i];
+	}
+
+	return closest;
+}
+
+#endif // svo_H__
@@ -0,0 +1,26 @@
+#include "raycast.hpp"
+#include "scene.hpp"
+#include "tile.hpp"
+
+// one compile-time rendered tile of the image; the tile grid and the position of this tile in it come from the build:
+// TILE_COLS x TILE_ROWS grid, this tile at column TILE_COL, row TILE_ROW
+#if !defined(TILE_COLS) || !defined(TILE_ROWS) || !defined(TILE_COL) || !defined(TILE_ROW)
+#error tile grid not specified
+#endif
+
+static_assert(TILE_COL < TILE_COLS && TILE_ROW < TILE_ROWS, "tile outside of tile grid");
+static_assert(TILE_COLS <= image_w && TILE_ROWS <= image_h, "tile grid finer than the image");
+
+constexpr int tile_x = tileOrigin(image_w, TILE_COLS, TILE_COL);
+constexpr int tile_y = tileOrigin(image_h, TILE_ROWS, TILE_ROW);
+constexpr int tile_w = tileExtent(image_w, TILE_COLS, TILE_COL);
+constexpr int tile_h = tileExtent(image_h, TILE_ROWS, TILE_ROW);
+
+__attribute__ ((used, section(TILE_SECTION_STR(TILE_SECTION)), aligned(alignof(TileDesc))))
+static const TileDesc tile = {
+	tile_x,
+	tile_y,
+	tile_w,
+	tile_h,
+	Image< image_w, image_h, cam, Scene, scene_accel, tile_x, tile_y, tile_w, tile_h >::pixels.data()
+};
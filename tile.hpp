@@ -0,0 +1,37 @@
+#ifndef tile_H__
+#define tile_H__
+
+#include "raycast.hpp"
+
+// descriptor of a compile-time rendered tile; each tile translation unit contributes one descriptor to a dedicated
+// section, which the linker concatenates into an array delimited by the __start_/__stop_ symbols of that section;
+// descriptors must be declared with their natural alignment, lest the compiler pads them apart
+struct TileDesc
+{
+	int x;
+	int y;
+	int w;
+	int h;
+	const Pixel* pixels;
+};
+
+#define TILE_SECTION raycast_tiles
+#define TILE_SECTION_STR_(s) #s
+#define TILE_SECTION_STR(s) TILE_SECTION_STR_(s)
+#define TILE_SECTION_BEGIN_(s) __start_ ## s
+#define TILE_SECTION_BEGIN(s) TILE_SECTION_BEGIN_(s)
+#define TILE_SECTION_END_(s) __stop_ ## s
+#define TILE_SECTION_END(s) TILE_SECTION_END_(s)
+
+// partition of an extent into count near-equal spans; spans at the front absorb the remainder
+constexpr int tileOrigin(int extent, int count, int index)
+{
+	return index * (extent / count) + (index < extent % count ? index : extent % count);
+}
+
+constexpr int tileExtent(int extent, int count, int index)
+{
+	return extent / count + (index < extent % count ? 1 : 0);
+}
+
+#endif // tile_H__
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "raycast.hpp"
+#include "scene.hpp"
+#include "tile.hpp"
+#include "imagebin.hpp"
+
+// link-time assembler of the compile-time rendered tiles -- collects the tile descriptors from all tile translation
+// units linked in, and writes out the image they cover
+
+extern const TileDesc TILE_SECTION_BEGIN(TILE_SECTION)[];
+extern const TileDesc TILE_SECTION_END(TILE_SECTION)[];
+
+int main(int, char**)
+{
+	const TileDesc* const tiles = TILE_SECTION_BEGIN(TILE_SECTION);
+	const size_t num_tiles = TILE_SECTION_END(TILE_SECTION) - TILE_SECTION_BEGIN(TILE_SECTION);
+
+	const size_t image_size = image_w * image_h;
+	static uint8_t image[image_size][sizeof(Pixel)];
+	static uint8_t coverage[image_size];
+
+	for (size_t i = 0; i < num_tiles; ++i) {
+		const TileDesc& tile = tiles[i];
+
+		if (tile.x < 0 || tile.y < 0 || tile.x + tile.w > image_w || tile.y + tile.h > image_h) {
+			fprintf(stderr, "error: tile (%d, %d, %d, %d) outside of image\n", tile.x, tile.y, tile.w, tile.h);
+			return -1;
+		}
+
+		for (int y = 0; y < tile.h; ++y) {
+			memcpy(image[(tile.y + y) * image_w + tile.x], tile.pixels + y * tile.w, sizeof(image[0]) * tile.w);
+
+			for (int x = 0; x < tile.w; ++x)
+				++coverage[(tile.y + y) * image_w + tile.x + x];
+		}
+	}
+
+	for (size_t i = 0; i < image_size; ++i) {
+		if (1 != coverage[i]) {
+			fprintf(stderr, "error: %zu tile(s) linked in; pixel (%zu, %zu) covered %d times\n",
+				num_tiles, i % image_w, i / image_w, int(coverage[i]));
+			return -1;
+		}
+	}
+
+	stream::out f;
+
+	if (f.open("image.bin", false)) {
+		// tiles are of near-equal rather than equal size, which a tile index cannot describe
+		const ImageHeader header = imageHeader(image_w, image_h);
+
+		if (!writeImageHeader(f, header) || !writeImageRows(f, header, image, image_h) || (f.flush(), !f.is_good()))
+			fprintf(stderr, "error: failure writing to file\n");
+
+		f.close();
+	}
+
+	return 0;
+}